@@ -0,0 +1,274 @@
+
+#define PICO_IMPLEMENTATION
+#include "PicoMsg.h"
+#include <vector>
+#include <algorithm>
+#include <sys/wait.h>
+using std::vector;
+
+// picobench: sweeps message size, buffer size, worker count and transport.
+// Prints one JSON object per line, so runs can be diffed or plotted.
+// Each line has the throughput (one-way, acknowledged at the end) and the round-trip latencies (ping-pong).
+
+const char* SelfPath;
+
+struct BenchRun {
+	const char*		Transport;
+	int				Workers;
+	int				Buff;
+	int				Size;
+};
+
+struct BenchResult {
+	double			Secs;
+	int				Msgs;
+	int				Pings;
+	double			P50;
+	double			P99;
+	double			P999;
+	double			Max;
+	PicoCommStats	Stats;
+};
+
+
+static int BenchCount (int Size, int Bytes, int Lo, int Hi) {
+	return std::clamp(Bytes / Size, Lo, Hi);
+}
+
+
+static bool BenchSend (PicoComms* M, const char* Data, int Length) {
+	while (!PicoSend(M, Data, Length, PicoSendCanTimeOut))
+		if (PicoError(M)) return false;
+	return true;
+}
+
+
+static void BenchEcho (PicoComms* M) {
+	// 'T' counts, 'L' counts and replies with the count, 'P' echoes back, 'Q' quits.
+	M->Noise = PicoSilent;
+	int Got = 0;
+	while (auto Msg = PicoGetView(M, 10.0)) {
+		char Op = Msg.Data[0];
+		bool OK = true;
+		if (Op == 'P')
+			OK = BenchSend(M, Msg.Data, Msg.Length);
+		PicoRelease(M);
+		if (Op == 'T') {
+			Got++;
+		} else if (Op == 'L') {
+			Got++;
+			OK = BenchSend(M, (const char*)&Got, sizeof(Got));
+			Got = 0;
+		}
+		if (Op == 'Q' or !OK) break;
+	}
+}
+
+
+static void BenchThread (PicoComms* M, uint, const char**) {
+	BenchEcho(M);
+}
+
+
+static void* BenchPair (void* M) {
+	BenchEcho((PicoComms*)M);
+	return nullptr;
+}
+
+
+static const char* BenchMeasure (PicoComms* C, BenchRun& R, BenchResult& Out) {
+	vector<char> Data(R.Size, 'x');
+
+	// throughput: send Msgs one-way, and wait for the count to come back.
+	Out.Msgs = BenchCount(R.Size, 64<<20, 16, 100000);
+	int64_t Start = pico_now_ns();
+	for (int i = 1; i <= Out.Msgs; i++) {
+		Data[0] = (i < Out.Msgs) ? 'T' : 'L';
+		if (!BenchSend(C, Data.data(), R.Size)) return "send failed";
+	}
+	auto Ack = PicoGetView(C, 30.0);
+	if (!Ack) return "no ack";
+	int Counted = *(int*)Ack.Data;
+	PicoRelease(C);
+	Out.Secs = (double)(pico_now_ns() - Start) / 1e9;
+	if (Counted != Out.Msgs) return "lost messages";
+
+	// latency: ping-pong, after a few to warm up. At least 1000, so p999 isn't just the max.
+	Out.Pings = BenchCount(R.Size, 16<<20, 1000, 10000);
+	vector<int64_t> Times;
+	Data[0] = 'P';
+	for (int i = -10; i < Out.Pings; i++) {
+		int64_t Sent = pico_now_ns();
+		if (!BenchSend(C, Data.data(), R.Size)) return "ping failed";
+		auto Pong = PicoGetView(C, 10.0);
+		if (!Pong) return "no pong";
+		bool Same = Pong.Length == R.Size;
+		PicoRelease(C);
+		if (!Same) return "bad pong";
+		if (i >= 0)
+			Times.push_back(pico_now_ns() - Sent);
+	}
+
+	std::sort(Times.begin(), Times.end());
+	auto At = [&](double P) {
+		size_t i = std::min(Times.size()-1, (size_t)(Times.size()*P));
+		return (double)Times[i] / 1000.0;
+	};
+	Out.P50 = At(0.5); Out.P99 = At(0.99); Out.P999 = At(0.999); Out.Max = At(1.0);
+	PicoCommInfo(C, &Out.Stats);
+	return nullptr;
+}
+
+
+static const char* BenchStart (PicoComms* C, BenchRun& R, PicoComms*& Pair, pthread_t& T, int& PID) {
+	if (!strcmp(R.Transport, "thread"))
+		return PicoStartThread(C, BenchThread) ? nullptr : "no thread";
+
+	if (!strcmp(R.Transport, "child")) {
+		Pair = PicoStartChild(C);
+		if (!Pair) return "no child";
+		return pthread_create(&T, nullptr, BenchPair, Pair) ? "no pthread" : nullptr;
+	}
+
+	if (!strcmp(R.Transport, "fork")) {
+		fflush(stdout);
+		PID = PicoStartFork(C, "BenchFork");
+		if (PID < 0) return "no fork";
+		if (!PID) {
+			BenchEcho(C);
+			_exit(0); // don't unwind back into the sweep.
+		}
+		return nullptr;
+	}
+
+	char W[16]; char B[16];
+	snprintf(W, sizeof(W), "%i", R.Workers);
+	snprintf(B, sizeof(B), "%i", R.Buff);
+	const char* Args[] = {SelfPath, "echo", W, B, nullptr};
+	PID = PicoExec(C, "BenchExec", Args);
+	return PID > 0 ? nullptr : "no exec";
+}
+
+
+static void BenchOne (BenchRun& R) {
+	BenchResult Out = {};
+	PicoComms* C = PicoCreate("Bench", R.Buff);
+	if (!C) {
+		printf("{\"transport\":\"%s\",\"workers\":%i,\"buffer\":%i,\"size\":%i,\"error\":\"no comm\"}\n",
+			R.Transport, R.Workers, R.Buff, R.Size);
+		return;
+	}
+	C->Noise = PicoSilent;
+	PicoComms* Pair = nullptr; pthread_t T = 0; int PID = 0;
+
+	const char* Err = BenchStart(C, R, Pair, T, PID);
+	if (!Err)
+		Err = BenchMeasure(C, R, Out);
+
+	PicoSend(C, "Q", 1);
+	if (T) pthread_join(T, nullptr);
+	if (PID > 0) waitpid(PID, nullptr, 0);
+	PicoDestroy(Pair);
+	PicoDestroy(C);
+
+	printf("{\"transport\":\"%s\",\"workers\":%i,\"buffer\":%i,\"size\":%i",
+		R.Transport, R.Workers, R.Buff, R.Size);
+	if (Err) {
+		printf(",\"error\":\"%s\"}\n", Err);
+	} else {
+		double Rate = Out.Msgs / Out.Secs;
+		printf(",\"msgs\":%i,\"msgs_per_sec\":%.0f,\"mb_per_sec\":%.2f", Out.Msgs, Rate, Rate*R.Size/1e6);
+		printf(",\"rtt_samples\":%i,\"rtt_p50_us\":%.1f,\"rtt_p99_us\":%.1f,\"rtt_p999_us\":%.1f,\"rtt_max_us\":%.1f",
+			Out.Pings, Out.P50, Out.P99, Out.P999, Out.Max);
+		printf(",\"send_calls\":%llu,\"read_calls\":%llu}\n",
+			(unsigned long long)Out.Stats.SendCalls, (unsigned long long)Out.Stats.ReadCalls);
+	}
+	fflush(stdout);
+}
+
+
+static vector<int> BenchList (const char* S) {
+	// "8,4K,1M" --> {8, 4096, 1048576}
+	vector<int> Rz;
+	while (S and *S) {
+		char* End = nullptr;
+		long N = strtol(S, &End, 10);
+		if (*End == 'K' or *End == 'k') {N <<= 10; End++;}
+		if (*End == 'M' or *End == 'm') {N <<= 20; End++;}
+		if (N > 0) Rz.push_back((int)N);
+		S = (*End == ',') ? End+1 : nullptr;
+	}
+	return Rz;
+}
+
+
+static int BenchEchoMain (int argc, const char* argv[]) {
+	PicoInit(argc > 2 ? atoi(argv[2]) : 0);
+	auto C = PicoCreate("BenchEcho", argc > 3 ? atoi(argv[3]) : 0);
+	if (!C or !PicoRestoreExec(C)) return -1;
+	BenchEcho(C);
+	return 0;
+}
+
+
+int main (int argc, const char* argv[]) {
+	SelfPath = argv[0];
+	if (argc > 1 and !strcmp(argv[1], "echo"))
+		return BenchEchoMain(argc, argv);
+
+	vector<int> Sizes   = BenchList("8,64,512,4K,32K,256K,1M");
+	vector<int> Buffs   = BenchList("64K,1M,8M");
+	vector<int> Workers = BenchList("1,2,4");
+	const char* Transports = "thread,child,fork,exec";
+
+	for (int i = 1; i < argc; i++) {
+		const char* A = argv[i];
+		const char* V = (i+1 < argc) ? argv[i+1] : nullptr;
+		if (!strcmp(A, "--quick")) {
+			Sizes = BenchList("8,4K,1M"); Buffs = BenchList("1M"); Workers = BenchList("1");
+			continue;
+		}
+		if (!V) {
+			fprintf(stderr, "usage: picobench [--quick] [--sizes 8,4K,1M] [--buffs 64K,1M] [--workers 1,2] [--transports thread,child,fork,exec]\n");
+			return 1;
+		}
+		i++;
+		if (!strcmp(A, "--sizes"))			Sizes = BenchList(V);
+		  else if (!strcmp(A, "--buffs"))	Buffs = BenchList(V);
+		  else if (!strcmp(A, "--workers"))	Workers = BenchList(V);
+		  else if (!strcmp(A, "--transports")) Transports = V;
+	}
+
+	// The worker count is fixed once Pico starts, so each count gets a fresh process.
+	int rz = 0;
+	for (int W : Workers) {
+		fflush(stdout);
+		pid_t PID = fork();
+		if (PID < 0) return 1;
+		if (PID) {
+			int Status = 0;
+			waitpid(PID, &Status, 0);
+			rz |= !WIFEXITED(Status) or WEXITSTATUS(Status);
+			continue;
+		}
+
+		PicoInit(W);
+		for (int B : Buffs) for (int S : Sizes) {
+			const char* T = Transports;
+			while (*T) {
+				const char* End = strchr(T, ',');
+				int n = End ? (int)(End-T) : (int)strlen(T);
+				char Name[16] = {};
+				memcpy(Name, T, std::min(n, 15));
+				T += n + (End != nullptr);
+				if (strcmp(Name, "thread") and strcmp(Name, "child") and strcmp(Name, "fork") and strcmp(Name, "exec"))
+					continue;
+				BenchRun R = {Name, W, B, S};
+				BenchOne(R);
+			}
+		}
+		PicoFinish();
+		_exit(0);
+	}
+	return rz;
+}
@@ -5,7 +5,7 @@
 /// Parent-child queue-based message-passing.
 /// The API is simple. Hides the complexity of message-passing. 
 /// Uses one (or more) worker threads, and is non-blocking.
-/// 64 communicators max. 
+/// 64K communicators max. (`PicoMaxComms`)
 
 /// Released 2024
 /// Author: Theodore H. Smith, http://gamblevore.org
@@ -31,11 +31,22 @@
 #define PicoExecOrphan			2
 #define PicoExecWantDead		4
 
+#define PicoMirrorBuffs			1
+#define PicoSharedMem			2
+#define PicoAdaptiveBuffs		4
+#define PicoPooledMsgs			8
+#define PicoCompressMsgs		16
+#define PicoTimedMsgs			32
+
 
 #ifndef PicoDefaultInitSize
 	#define PicoDefaultInitSize (1024*1024)
 #endif
 
+#ifndef PicoMaxComms
+	#define PicoMaxComms (64*1024) // Allocated 64 at a time, as needed.
+#endif
+
 #include <stdint.h> // for picodate
 
 /// todo: Could remove some locks, for a pico hard-coded to one worker-thread
@@ -45,6 +56,7 @@ typedef	int64_t	PicoDate;  // Resolution is 1s/64K, at ±445M years range.
 
 struct			PicoComms;
 struct			PicoGlobalConfig;
+struct			iovec;
 
 #pragma pack(push, 1)
 struct			PicoMessage { char* Data; int Length;  operator bool () {return Data;}; };
@@ -63,22 +75,86 @@ typedef char*   (*PicoAppenderFn)(void* Obj, int Length);
 	#include <signal.h>
 	#include <errno.h>
 	#include <sys/socket.h>
+	#include <sys/uio.h>
+	#include <sys/mman.h>
+	#include <sys/wait.h>
+	#include <string.h>
+	#include <math.h>
+	#if __linux__
+		#include <sched.h>
+		#include <sys/epoll.h>
+		#include <sys/eventfd.h>
+		#include <sys/syscall.h>
+		#include <linux/futex.h>
+	#endif
+	#if PICO_URING and __linux__
+		#include <linux/io_uring.h>
+		#include <poll.h>
+		#ifndef IORING_SQ_CQ_OVERFLOW
+			#define IORING_SQ_CQ_OVERFLOW (1U << 1)
+		#endif
+	#endif
 	#include <algorithm>
 	#include <atomic>
 
+static const int PicoMore = 1<<30; // In a message header: more pieces follow. No buffer is big enough to need this bit.
+static const int PicoPacked = 1<<29; // In a message header: the body is compressed.
+static const int PicoStamped = 1<<28; // In a message header: the body starts with the time it was sent. Messages this big always go in pieces.
+static const int PicoFlags = PicoMore|PicoPacked|PicoStamped;
+
 struct PicoBuff;
+struct PicoQueue;
+struct PicoMsgPool;
+struct PicoLatency;
+struct PicoOp;
+static void pico_futex_wait (std::atomic_uint* Addr, unsigned int Expected, float Seconds);
+static void pico_futex_wake (std::atomic_uint* Addr, int Count);
+
+inline void pico_pause () {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	asm volatile ("yield");
+#endif
+}
+
 struct PicoTrousers { // only one person can wear them at a time.
-	std::atomic_bool Value;
-	PicoTrousers  () {Value = false;}
+	std::atomic_uint Value;				// 0 = free, 1 = worn, 2 = worn and someone is asleep waiting.
+	std::atomic_uint Contended;			// how often `enter()` failed, or `lock()` had to wait.
+	PicoTrousers  () {Value = 0; Contended = 0;}
 	bool enter () {
-		bool Expected = false;
-		return Value.compare_exchange_strong(Expected, true);
+		unsigned int Expected = 0;
+		if (Value.compare_exchange_strong(Expected, 1))
+			return true;
+		Contended++;
+		return false;
 	}
 	void leave () {
-		Value = false;
+		if (Value.exchange(0) == 2)
+			pico_futex_wake(&Value, 1);
 	}
 	void lock () {
-		while (!enter()); // spin
+		if (enter()) return;
+		for (int i = 0; i < 128; i++) {	// spin a little. Most holds are short.
+			pico_pause();
+			unsigned int Expected = 0;
+			if (Value == 0 and Value.compare_exchange_weak(Expected, 1))
+				return;
+		}
+		while (Value.exchange(2) != 0)	// then sleep, so the holder can run.
+			pico_futex_wait(&Value, 2, 1.0f);
+	}
+};
+
+struct PicoCounters { // Per comm. Relaxed atomics, so counting costs next to nothing.
+	std::atomic_uint64_t MsgsSent, MsgsGot, BytesSent, BytesGot, SendCalls, ReadCalls, Again, BufferFull, BlockedNS;
+	std::atomic_int		SendingPeak, ReadingPeak;
+	static void Add (std::atomic_uint64_t& C, uint64_t N=1) {
+		C.fetch_add(N, std::memory_order_relaxed);
+	}
+	static void Peak (std::atomic_int& P, int N) {
+		if (N > P.load(std::memory_order_relaxed))
+			P.store(N, std::memory_order_relaxed);
 	}
 };
 #endif
@@ -96,7 +172,15 @@ struct 			PicoConfig  {
 	unsigned char		SendTimeOut;	/// The number of seconds before a send will timeout (if the send is not instant)
 	unsigned char		Bits; 			/// The size we used to allocate stuff:  1 << Bits
 	bool				IsParent;		/// Are we the parent.
+	bool				ZeroCopy;		/// Set by `PicoGetView()`, cleared by `PicoGet()`. Stops the worker copying messages out of the read-buffer.
 	unsigned char		ExecFlags;
+	unsigned char		Options;		/// Flags like `PicoMirrorBuffs` or `PicoSharedMem`. Set these before starting the comms.
+	int					UnreadLimit;	/// The maximum unread-message queue size, in bytes. Defaults to 8x the buffer size.
+	int					MinBuffSize;	/// With `PicoAdaptiveBuffs`, buffers don't shrink below this. Defaults to 16KB.
+	int					MaxBuffSize;	/// With `PicoAdaptiveBuffs`, buffers don't grow above this. Defaults to 16x the starting size.
+	int					PackAbove;		/// With `PicoCompressMsgs`, messages this big or bigger get compressed. Defaults to 256 bytes.
+	int					SendBatch;		/// The worker holds back sends until this many bytes are waiting. 0 sends right away. Defaults to 0.
+	int					SendDelay;		/// ...but holds them back no longer than this, in microseconds. Defaults to 200.
 #if defined(PICO_IMPLEMENTATION) || defined(PICO_SEE_INTERNALS) /// Don't alter the internals. 
 	unsigned char		SocketStatus;
 	unsigned char		PartClosed;
@@ -110,9 +194,33 @@ struct 			PicoConfig  {
 	PicoBuff*			Sending;
 	PicoBuff*			StdErr;
 	PicoBuff*			StdOut;
-	std::atomic<char*>	PreData;
+	std::atomic<PicoQueue*>	Unread;
 	int					PreLength;
+	char*				Partial;		// A message too big for the buffers, being put back together.
+	int					PartialLength;
+	int					PartialCap;
+	int					ViewLength;
+	char*				Reserved;
+	int					ReserveMax;
+	unsigned int		Notified;
+	std::atomic_bool	Retry;
+	bool				ReadStalled;
+	std::atomic_uint	Arrivals;
+	std::atomic_int		Waiting;
+	bool				ReserveCopy;
 	bool				KeepAlive;
+	unsigned char		Worker;			// Which worker owns us. 1-based. 0 = not placed yet.
+	std::atomic_uint	Traffic;		// Bytes moved since the last rebalance.
+	std::atomic<PicoDate> HeldSince;	// When `SendBatch` started holding back the bytes in `Sending`. 0 = not holding.
+	std::atomic_bool	FlushNow;		// Set by `PicoFlush()`.
+	PicoOp*				Ops;			// io_uring ops. Send, Read, StdOut, StdErr.
+	PicoBuff*			Retired[2];		// Replaced by a resize. Freed a little later, in case someone still looks.
+	PicoMsgPool*		Pool;			// With `PicoPooledMsgs`.
+	PicoLatency*		Latency;		// Timings of messages sent with `PicoTimedMsgs`.
+	PicoCounters		Counts;			// For `PicoCommInfo()`.
+	char*				Packing;		// With `PicoCompressMsgs`. Scratch space for the sender.
+	int					PackingCap;
+	unsigned char		RetiredAge[2];
 #endif
 };
 
@@ -145,10 +253,53 @@ struct PicoGlobalConfig {
 };
 
 
+struct PicoCommStats {			/// From `PicoCommInfo()`. Counted since the comm was created.
+	uint64_t		MsgsSent;
+	uint64_t		MsgsGot;		/// Messages taken out of the read-buffer.
+	uint64_t		BytesSent;		/// Message bytes, not counting headers, or compression.
+	uint64_t		BytesGot;
+	uint64_t		SendCalls;		/// Send syscalls. (Or io_uring sends.)
+	uint64_t		ReadCalls;		/// Read syscalls on the message socket.
+	uint64_t		Again;			/// Syscalls that said `EAGAIN`.
+	uint64_t		BufferFull;		/// Sends that found the send-buffer full.
+	double			BlockedTime;	/// Seconds senders spent waiting for space in the send-buffer.
+	int				SendingPeak;	/// Most bytes ever waiting in the send-buffer.
+	int				ReadingPeak;	/// Most bytes ever waiting in the read-buffer.
+};
+
+
 struct PicoGlobalStats {
 	int			TimeOutCount;
 	int         OpenSockets;
 	int			OpenPicos;
+	int			Capacity;		/// How many comms fit, before we allocate more.
+	PicoCommStats	All;		/// Every comm's counters added up. Including ones already destroyed. Peaks are the biggest of any comm.
+};
+
+
+struct PicoPoolStats {			/// From `PicoPoolInfo()`
+	unsigned int	Hits;			/// Messages that reused a pooled buffer.
+	unsigned int	Misses;			/// Messages that needed a `malloc()`.
+	unsigned int	TooBig;			/// Messages too big to pool. Always `malloc()`ed.
+	int				CachedBytes;	/// Memory sitting in the pool, ready for reuse.
+	float			HitRate;		/// Hits / All
+};
+
+
+struct PicoLatencyStats {		/// From `PicoLatencyInfo()`. In microseconds, from sending a message, to it being got.
+	unsigned int	Count;			/// How many messages were timed.
+	float			P50;			/// Half of them took less than this.
+	float			P99;
+	float			P999;
+	float			Max;
+};
+
+
+struct PicoLockStats {			/// How often each lock was busy, when someone wanted it.
+	unsigned int	SendLock;
+	unsigned int	ReadLock;
+	unsigned int	GrabLock;
+	unsigned int	InUse;
 };
 
 
@@ -175,6 +326,11 @@ PicoDate pico_date_create ( uint64_t S, uint64_t NS ) {
     return (S << 16) + NS2;
 }
 
+int64_t pico_now_ns () { // same clock as `PicoNow()`, but finer. Socket latencies are a few µs.
+	timespec ts; clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 PicoDate PicoNow () {
 	timespec ts; clock_gettime(CLOCK_REALTIME, &ts);
 	return pico_date_create(ts.tv_sec, ts.tv_nsec);
@@ -198,22 +354,183 @@ inline int pico_log2 (uint64_t X) {
 }
 
 
+// A tiny LZ77 codec, in the style of LZ4. Fast rather than tight: it only needs to beat the socket.
+// Packed layout: the unpacked length (4 bytes). Then runs of: token, literal-length, literals, offset, match-length.
+// The token's top 4 bits are the literal-length, the bottom 4 are the match-length - 4. 15 means more bytes follow.
+
+inline int pico_lz_bound (int N) {
+	return N + N/255 + 16;
+}
+
+inline uint8_t* pico_lz_len (uint8_t* O, int N) {
+	for (; N >= 255; N -= 255)
+		*O++ = 255;
+	*O++ = N;
+	return O;
+}
+
+inline uint32_t pico_lz_read4 (const uint8_t* P) {
+	uint32_t R; memcpy(&R, P, 4);
+	return R;
+}
+
+static int pico_lz_pack (const char* Src, int N, char* Out, int Cap) {
+	// Returns the packed size, or 0 if it won't fit in `Cap`.
+	if (N < 16 or Cap < 8) return 0;
+	auto S = (const uint8_t*)Src;
+	auto O = (uint8_t*)Out;
+	auto End = O + Cap;
+	int Len = letoh(N);
+	memcpy(O, &Len, 4); O += 4;
+	
+	int Table[4096] = {};								// where each hash was last seen, +1
+	int Anchor = 0;
+	int Last = N - 12;									// leave some literals at the end, like LZ4.
+	for (int i = 0; i < Last;) {
+		uint32_t Seq = pico_lz_read4(S+i);
+		uint32_t H = (Seq * 2654435761u) >> 20;
+		int Cand = Table[H] - 1;
+		Table[H] = i + 1;
+		if (Cand < 0 or i - Cand > 65535 or pico_lz_read4(S+Cand) != Seq) {
+			i += 1 + ((i - Anchor) >> 6);				// skip faster through incompressible data.
+			continue;
+		}
+		int M = 4;
+		while (i + M < N - 5 and S[Cand+M] == S[i+M])
+			M++;
+		
+		int Lit = i - Anchor;
+		if (End - O < Lit + Lit/255 + M/255 + 6) return 0;
+		uint8_t* Token = O++;
+		*Token = (std::min(Lit, 15) << 4) | std::min(M-4, 15);
+		if (Lit >= 15) O = pico_lz_len(O, Lit-15);
+		memcpy(O, S+Anchor, Lit); O += Lit;
+		int Off = i - Cand;
+		*O++ = Off & 255; *O++ = Off >> 8;
+		if (M-4 >= 15) O = pico_lz_len(O, M-4-15);
+		i += M;
+		Anchor = i;
+	}
+	
+	int Lit = N - Anchor;								// the last run is just literals.
+	if (End - O < Lit + Lit/255 + 2) return 0;
+	*O++ = std::min(Lit, 15) << 4;
+	if (Lit >= 15) O = pico_lz_len(O, Lit-15);
+	memcpy(O, S+Anchor, Lit); O += Lit;
+	return (int)(O - (uint8_t*)Out);
+}
+
+inline int pico_lz_size (const char* In, int N) {		// the unpacked length, or -1.
+	if (N < 8) return -1;
+	int Len; memcpy(&Len, In, 4);
+	Len = htole(Len);
+	return Len > 0 ? Len : -1;
+}
+
+static int pico_lz_unpack (const char* In, int N, char* Dst, int Cap) {
+	// Returns the unpacked size, or -1 if `In` is corrupt.
+	auto I = (const uint8_t*)In + 4;
+	auto End = (const uint8_t*)In + N;
+	auto O = (uint8_t*)Dst;
+	auto OEnd = O + Cap;
+	while (I < End) {
+		int T = *I++;
+		int Lit = T >> 4;
+		if (Lit == 15) for (int B = 255; B == 255; Lit += B) {
+			if (I >= End or Lit > Cap) return -1;
+			B = *I++;
+		}
+		if (Lit > End - I or Lit > OEnd - O) return -1;
+		memcpy(O, I, Lit); I += Lit; O += Lit;
+		if (I == End) break;							// the last run has no match.
+		
+		if (End - I < 2) return -1;
+		int Off = I[0] | (I[1] << 8); I += 2;
+		int M = T & 15;
+		if (M == 15) for (int B = 255; B == 255; M += B) {
+			if (I >= End or M > Cap) return -1;
+			B = *I++;
+		}
+		M += 4;
+		if (!Off or Off > O - (uint8_t*)Dst or M > OEnd - O) return -1;
+		for (uint8_t* From = O - Off; M > 0; M--)		// may overlap, so byte by byte.
+			*O++ = *From++;
+	}
+	return (int)(O - (uint8_t*)Dst);
+}
+
+
 struct PicoCommList {
-	std::atomic_uint64_t		Map;
+	// Chunks of 64 comms. Chunks never move or get freed, so a comm's address is stable.
+	// `Maps` says which slots are taken, `Shown` which ones the workers may touch.
+	std::atomic_uint64_t		Maps[PicoMaxComms/64];
+	std::atomic_uint64_t		Shown[PicoMaxComms/64];
+	std::atomic<PicoConfig*>	Chunks[PicoMaxComms/64];
+	std::atomic_int				Count;
 	
 	int Reserve () {
-		uint64_t F0 = Map;
-		while (auto F = ~F0) {
-			F &= -F;
-			if (Map.compare_exchange_strong(F0, F|F0))
-				return pico_log2(F)+1;
+		for (int c = 0; c < PicoMaxComms/64; c++) {
+			if (c >= Count and !Grow(c))
+				return 0;
+			auto& Map = Maps[c];
+			uint64_t F0 = Map;
+			while (auto F = ~F0) {
+				F &= -F;
+				if (Map.compare_exchange_strong(F0, F|F0))
+					return c*64 + pico_log2(F)+1;
+			}
 		}
 		return 0;
 	}           						 ;;;/*_*/;;;
 	
-	void Remove (uint64_t M) {
-		uint64_t Mask = ~(1ULL << M);
-		Map &= Mask;
+	bool Grow (int c) {
+		if (!Chunks[c]) {
+			auto Fresh = (PicoConfig*)calloc(64, sizeof(PicoConfig));
+			if (!Fresh) return false;
+			PicoConfig* Expected = nullptr;
+			if (!Chunks[c].compare_exchange_strong(Expected, Fresh))
+				free(Fresh);				// someone else beat us to it.
+		}
+		int N = Count;
+		while (N <= c and !Count.compare_exchange_weak(N, c+1))
+			;
+		return true;
+	}
+	
+	void Show (int M) {				// once it's set up. Before this, sweeps skip it.
+		Shown[M>>6] |= 1ULL << (M&63);
+	}
+	
+	bool Hide (int M) {				// false if it wasn't shown, so only one caller gets to clear it.
+		if (M < 0) return false;
+		uint64_t Bit = 1ULL << (M&63);
+		return Shown[M>>6].fetch_and(~Bit) & Bit;
+	}
+	
+	void Remove (int M) {			// after it's cleared. Then it can be reused.
+		if (M < 0) return;
+		uint64_t Mask = ~(1ULL << (M&63));
+		Maps[M>>6] &= Mask;
+	}
+	
+	PicoConfig* At (int M) {
+		return Chunks[M>>6].load() + (M&63);
+	}
+	
+	int IndexOf (const void* P) {
+		for (int c = 0; c < Count; c++) {
+			auto Base = Chunks[c].load();
+			if (P >= Base and P < Base+64)
+				return c*64 + (int)((PicoConfig*)P - Base);
+		}
+		return -1;
+	}
+	
+	int Live () {
+		int N = 0;
+		for (int c = 0; c < Count; c++)
+			N += __builtin_popcountll(Maps[c]);
+		return N;
 	}
 };
 
@@ -222,30 +539,310 @@ struct PicoCommList {
 static	PicoCommList			pico_list;
 static	std::atomic_int			pico_thread_count;
 static	PicoTrousers			pico_inited;
+static	bool					pico_started;		// under `pico_inited`. Workers count themselves later.
 static	int						pico_timeout_count;
 static  std::atomic_int         pico_open_sockets;
 static  PicoGlobalConfig		pico_global_conf;
-static	PicoConfig				pico_all[64];
+static  PicoCommStats			pico_dead_stats;	// Counters of destroyed comms.
+static	PicoTrousers			pico_dead_lock;
+
+
+struct PicoWorker { // Each comm belongs to one worker. So workers don't fight over the same comms.
+	int					Epoll = -1;
+	int					WakeFD = -1;
+	std::atomic_bool	WakePending;
+	std::atomic_int		Comms;			// how many comms it owns.
+	PicoDate			LastCheck;
+	std::atomic<PicoDate> FlushBy;		// The soonest any of its comms wants held-back bytes sent. 0 = none.
+	int					Node = -1;		// The NUMA node it last ran on.
+	bool				Pinned;
+	pthread_t			Thread;
+#if __linux__
+	cpu_set_t			CPUs;			// Set by `PicoPinWorker()`
+#endif
+};
+
+static	PicoWorker				pico_workers[6];
+static	int						pico_worker_count;
+
+
+static void pico_wake (int W) { // tell worker `W` something changed, that it can't see with epoll.
+#if __linux__
+	auto& K = pico_workers[std::max(W, 1)-1];
+	if (K.WakeFD >= 0 and !K.WakePending.exchange(true)) {
+		uint64_t One = 1;
+		if (write(K.WakeFD, &One, sizeof(One))) {;}
+	}
+#endif
+}
+
+
+static void pico_flush_by (int W, PicoDate By) { // make sure worker `W` wakes up by then.
+	auto& F = pico_workers[std::max(W, 1)-1].FlushBy;
+	PicoDate Old = F;
+	while ((!Old or By < Old) and !F.compare_exchange_weak(Old, By))
+		;
+}
+
+
+static int pico_numa_nodes () {
+	static int N = 0;
+	if (!N) {
+		int Found = 1;
+		char Path[64];
+		while (Found < 64) {
+			snprintf(Path, sizeof(Path), "/sys/devices/system/node/node%i", Found);
+			if (access(Path, F_OK)) break;
+			Found++;
+		}
+		N = Found;
+	}
+	return N;
+}
+
+
+static int pico_node_here () {
+#if __linux__
+	unsigned int CPU = 0; unsigned int Node = 0;
+	if (!syscall(SYS_getcpu, &CPU, &Node, nullptr))
+		return Node;
+#endif
+	return -1;
+}
+
+
+static void pico_bind (void* Addr, size_t Len, int Node) { // prefer `Node` for these pages, when first touched.
+#if __linux__
+	if (Node < 0 or Node >= 64) return;
+	uintptr_t Page = sysconf(_SC_PAGESIZE);
+	uintptr_t A = (uintptr_t)Addr & ~(Page-1);
+	unsigned long Mask = 1UL << Node;
+	syscall(SYS_mbind, A, Len + ((uintptr_t)Addr - A), 1, &Mask, 64, 0); // 1 = MPOL_PREFERRED
+#endif
+}
+
+
+static bool pico_pin (PicoWorker& K) {
+#if __linux__
+	if (!K.Thread) return true;							// not started yet. It pins itself when it does.
+	cpu_set_t All;
+	if (!K.Pinned) {
+		CPU_ZERO(&All);
+		for (int i = 0; i < CPU_SETSIZE; i++)
+			CPU_SET(i, &All);
+	}
+	return !pthread_setaffinity_np(K.Thread, sizeof(cpu_set_t), K.Pinned ? &K.CPUs : &All);
+#else
+	return false;
+#endif
+}
+
+
+static int pico_least_loaded () {
+	int Best = 0;
+	for (int i = 1; i < pico_worker_count; i++)
+		if (pico_workers[i].Comms < pico_workers[Best].Comms)
+			Best = i;
+	return Best+1;
+}
+
+
+static void pico_futex_wait (std::atomic_uint* Addr, unsigned int Expected, float Seconds) {
+	Seconds = std::min(Seconds, 1000.0f);
+#if __linux__
+	timespec ts = {(time_t)Seconds, (long)((Seconds - floorf(Seconds))*1000000000.0f)};
+	syscall(SYS_futex, (uint32_t*)Addr, FUTEX_WAIT, Expected, &ts, nullptr, 0);
+#else
+	if (*Addr == Expected)
+		PicoSleep(std::min(Seconds, 0.001f));
+#endif
+}
+
+
+static void pico_futex_wake (std::atomic_uint* Addr, int Count=INT32_MAX) { // not private, so shared-memory works too.
+#if __linux__
+	syscall(SYS_futex, (uint32_t*)Addr, FUTEX_WAKE, Count, nullptr, nullptr, 0);
+#endif
+}
+
+
+#if PICO_URING and __linux__
+struct PicoOp {
+	std::atomic_int		State;			// 0 = idle, 1 = posted, 2 = done. `Result` is valid.
+	int					Result;
+	bool				Cancelling;
+	iovec				V[2];
+	msghdr				Hdr;
+};
+
+
+struct PicoUring { // Just enough io_uring to keep one op per pipe/socket in-flight. No liburing needed.
+	int					FD = -1;
+	unsigned*			SQHead;
+	unsigned*			SQTail;
+	unsigned*			SQMask;
+	unsigned*			SQArray;
+	unsigned*			SQFlags;
+	unsigned*			CQHead;
+	unsigned*			CQTail;
+	unsigned*			CQMask;
+	io_uring_sqe*		SQEs;
+	io_uring_cqe*		CQEs;
+	void*				Maps[3];
+	size_t				MapLens[3];
+	PicoTrousers		SubmitLock;
+	PicoTrousers		ReapLock;
+	unsigned			SQSize = 256;		// Set these before `PicoInit()`, if you want.
+	unsigned			CQSize = 4096;		// a linked poll+op gives two completions.
+	std::atomic_uint	Overflows;			// times the completion ring filled up.
+	
+	bool Init () {
+		if (FD >= 0) return true;			// already live. A second ring would orphan its ops.
+		io_uring_params P = {};
+		P.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+		P.cq_entries = CQSize;
+		int F = (int)syscall(__NR_io_uring_setup, SQSize, &P);
+		if (F < 0 and errno == EINVAL) {	// older kernels. Overflows still get flushed by the reaper.
+			P = {};
+			F = (int)syscall(__NR_io_uring_setup, SQSize, &P);
+		}
+		if (F < 0) return false;
+		bool One = P.features & IORING_FEAT_SINGLE_MMAP;
+		MapLens[0] = P.sq_off.array + P.sq_entries*sizeof(unsigned);
+		MapLens[1] = P.cq_off.cqes  + P.cq_entries*sizeof(io_uring_cqe);
+		MapLens[2] = P.sq_entries*sizeof(io_uring_sqe);
+		if (One)
+			MapLens[0] = MapLens[1] = std::max(MapLens[0], MapLens[1]);
+		int RW = PROT_READ|PROT_WRITE;
+		Maps[0] = mmap(0, MapLens[0], RW, MAP_SHARED|MAP_POPULATE, F, IORING_OFF_SQ_RING);
+		Maps[1] = One ? Maps[0] : mmap(0, MapLens[1], RW, MAP_SHARED|MAP_POPULATE, F, IORING_OFF_CQ_RING);
+		Maps[2] = mmap(0, MapLens[2], RW, MAP_SHARED|MAP_POPULATE, F, IORING_OFF_SQES);
+		FD = F;
+		if (Maps[0] == MAP_FAILED or Maps[1] == MAP_FAILED or Maps[2] == MAP_FAILED)
+			return Close();
+		
+		char* SQ = (char*)Maps[0]; char* CQ = (char*)Maps[1];
+		SQHead  = (unsigned*)(SQ + P.sq_off.head);
+		SQTail  = (unsigned*)(SQ + P.sq_off.tail);
+		SQMask  = (unsigned*)(SQ + P.sq_off.ring_mask);
+		SQArray = (unsigned*)(SQ + P.sq_off.array);
+		SQFlags = (unsigned*)(SQ + P.sq_off.flags);
+		CQHead  = (unsigned*)(CQ + P.cq_off.head);
+		CQTail  = (unsigned*)(CQ + P.cq_off.tail);
+		CQMask  = (unsigned*)(CQ + P.cq_off.ring_mask);
+		CQEs    = (io_uring_cqe*)(CQ + P.cq_off.cqes);
+		SQEs    = (io_uring_sqe*)Maps[2];
+		return true;
+	}
+	
+	bool Close () {
+		for (int i = 0; i < 3; i++) {
+			if (Maps[i] and Maps[i] != MAP_FAILED and !(i == 1 and Maps[1] == Maps[0]))
+				munmap(Maps[i], MapLens[i]);
+			Maps[i] = nullptr;
+		}
+		if (FD >= 0) close(FD);
+		FD = -1;
+		return false;
+	}
+	
+	void Enter () {
+		unsigned N = __atomic_load_n(SQTail, __ATOMIC_RELAXED) - __atomic_load_n(SQHead, __ATOMIC_ACQUIRE);
+		if (N) while (syscall(__NR_io_uring_enter, FD, N, 0, 0, nullptr, 0) < 0 and errno == EINTR)
+			;	// EBUSY? The sqe stays queued, and the next Enter() takes it.
+	}
+	
+	bool Overflowed () { // the completion ring filled up, and the kernel is holding the rest back.
+		if (!(__atomic_load_n(SQFlags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW)) return false;
+		Overflows++;
+		while (syscall(__NR_io_uring_enter, FD, 0, 0, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 and errno == EINTR)
+			;	// moves them into the ring, now that we made room.
+		return true;
+	}
+	
+	bool Submit (const io_uring_sqe* S, int N) { // false if the ring is full. Then just do it the old way.
+		SubmitLock.lock();
+		unsigned T = *SQTail;
+		bool OK = T - __atomic_load_n(SQHead, __ATOMIC_ACQUIRE) + N <= *SQMask + 1;
+		if (OK) {
+			for (int j = 0; j < N; j++) {
+				unsigned i = (T+j) & *SQMask;
+				SQEs[i] = S[j];
+				SQArray[i] = i;
+			}
+			__atomic_store_n(SQTail, T+N, __ATOMIC_RELEASE);
+			Enter();
+		}
+		SubmitLock.leave();
+		return OK;
+	}
+};
+
+static	PicoUring				pico_uring;
+#else
+struct PicoOp {};
+#endif
+
+
+static void pico_forked () { // the child doesn't get the threads, so shouldn't get their epoll either.
+	pico_thread_count = 0;
+	pico_started = false;
+#if PICO_URING and __linux__
+	pico_uring.Close();			// the mapping is shared with the parent's ring. Don't touch it.
+#endif
+	for (auto& K : pico_workers) {
+		if (K.Epoll >= 0)	close(K.Epoll);
+		if (K.WakeFD >= 0)	close(K.WakeFD);
+		K.Epoll = -1;
+		K.WakeFD = -1;
+		K.WakePending = false;
+		K.Comms = 0;
+		K.Node = -1;
+		K.Thread = {};		// the parent's. We keep its CPU sets though.
+	}
+	pico_worker_count = 0;
+}
 
 
 struct PicoLister {
 	uint64_t SavedList;
-	PicoLister () {SavedList = pico_list.Map;}
+	int Chunk;
+	int Chunks;
+	PicoLister () {Chunk = 0; Chunks = pico_list.Count; SavedList = Chunks ? pico_list.Shown[0].load() : 0;}
 	
 	PicoComms* NextComm () {
-		auto L = SavedList;
-		if (L) {
-			auto Lowest = L & -L;
-			L &= ~Lowest;
-			SavedList = L;
-			return (PicoComms*)&(pico_all[pico_log2(Lowest)]);
+		while (!SavedList) {					// empty chunks cost one load each.
+			if (++Chunk >= Chunks) return 0;
+			SavedList = pico_list.Shown[Chunk];
 		}
-		return 0;
+		auto L = SavedList;
+		auto Lowest = L & -L;
+		SavedList = L & ~Lowest;
+		return (PicoComms*)pico_list.At(Chunk*64 + pico_log2(Lowest));
 	}
 };
 
 
 
+static int pico_memfd (int Size, bool Inherit=false) {
+#if __linux__
+	int FD = memfd_create("PicoMsg", Inherit ? 0 : MFD_CLOEXEC);
+#else
+	static std::atomic_int Count;
+	char Path[32]; snprintf(Path, sizeof(Path), "/PicoMsg%i.%i", getpid(), Count++);
+	int FD = shm_open(Path, O_RDWR|O_CREAT|O_EXCL, 0600);
+	if (FD >= 0) shm_unlink(Path);
+	if (FD >= 0 and !Inherit) fcntl(FD, F_SETFD, FD_CLOEXEC);
+#endif
+	if (FD >= 0 and ftruncate(FD, Size)) {
+		close(FD);
+		return -1;
+	}
+	return FD;
+}
+
+
+
 //#ifdef PICO_DEBUG_LOG
 //	#include <fcntl.h>
 //	#include <sys/stat.h>
@@ -255,7 +852,7 @@ struct PicoLister {
 
 
 struct PicoBuff {
-	const char*			Name;
+	char				Name[8];
 	std::atomic_uint	Tail;
 	std::atomic_uint	Head;
 	int					Size;
@@ -265,19 +862,29 @@ struct PicoBuff {
 //	#endif
 	void*				ThreadArgs;
 	int					ThreadMode;
+	int					MapSize;		// non-zero if mirrored
+	int					PlainMap;		// non-zero if mmapped, to put it on a NUMA node
+	bool				Shared;			// between processes. Each process unmaps its own.
 	std::atomic_short	RefCount;
+	std::atomic_int		Waiters;		// blocked senders, sleeping on `Tail`
+	int					Peak;			// Most bytes held, since the last check. For `PicoAdaptiveBuffs`.
+	unsigned short		Fills;			// Times it was full, since the last check.
+	unsigned char		Quiet;			// Checks in a row, where it was mostly empty.
+	bool				Shrink;			// The worker wants it smaller. Whoever fills it, does it.
+	PicoBuff*			Older;			// Retired buffers, waiting to be freed.
 	char				Data[0];             ;;;/*_*/;;;
 
-	static PicoBuff* New (int bits, const char* name, PicoComms* O, int pipe) { // 🕷️vv🕷️
-		PicoBuff* Rz = nullptr; 
-		do {
+	static PicoBuff* New (int bits, const char* name, PicoComms* O, int pipe, bool Mirror=false, int Node=-1) { // 🕷️vv🕷️
+		(void)O;
+		PicoBuff* Rz = Mirror ? NewMirror(bits, Node) : nullptr;
+		if (!Rz and Node >= 0)
+			Rz = NewOnNode(bits, Node);
+		while (!Rz) {
 			if ((Rz = (PicoBuff*)calloc((1<<bits)+sizeof(PicoBuff), 1))) break;
 			if (bits < 9) return nullptr;
 			bits--; 
-		} while (true);
-		Rz->Tail = 0; Rz->Head = 0; Rz->ThreadArgs = 0; Rz->ThreadMode = 0;
-		Rz->RefCount = 1; Rz->Pipe = pipe;
-		Rz->Size = 1<<bits; Rz->Name = name;
+		}
+		Rz->Init(bits, name, pipe);
 //	#ifdef PICO_DEBUG_LOG
 //		char Path[128] = {};
 //		snprintf(Path, sizeof(Path), "%s/%s/%s%s.txt", PICO_DEBUG_LOG, PicoCommsConf(O)->Name, PicoCommsConf(O)->Name, name);
@@ -298,8 +905,55 @@ struct PicoBuff {
 //	#endif
 		return Rz;
 	}
+	
+	void Init (int bits, const char* name, int pipe) {
+		Tail = 0; Head = 0; ThreadArgs = 0; ThreadMode = 0; Waiters = 0;
+		RefCount = 1; Pipe = pipe;
+		Size = 1<<bits; strncpy(Name, name, sizeof(Name)-1);
+	}
+	
+	static PicoBuff* NewMirror (int bits, int Node) {
+		// The same pages, mapped twice back-to-back. So every used/unused region is contiguous.
+		int S = 1<<bits;
+		int Page = (int)sysconf(_SC_PAGESIZE);
+		if (S < Page) return nullptr;
+		int FD = pico_memfd(Page + S);
+		if (FD < 0) return nullptr;
+		PicoBuff* Rz = Map(FD, 0, S, Page);
+		close(FD);
+		if (Rz) pico_bind(Rz->Data - Page, Page + 2*S, Node);
+		return Rz;
+	}
+	
+	static PicoBuff* NewOnNode (int bits, int Node) { // like calloc, but the pages come from `Node`.
+		size_t Total = sizeof(PicoBuff) + (1<<bits);
+		void* Base = mmap(nullptr, Total, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (Base == MAP_FAILED) return nullptr;
+		pico_bind(Base, Total, Node);
+		auto Rz = (PicoBuff*)Base;
+		Rz->PlainMap = (int)Total;
+		return Rz;
+	}
+	
+	static PicoBuff* Map (int FD, off_t Off, int S, int Page) {
+		// [header page][data][data again]. The header sits at the end of its page, so Data is page-aligned.
+		int Total = Page + S + S;
+		char* Base = (char*)mmap(nullptr, Total, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (Base == MAP_FAILED) return nullptr;
+		int RW = PROT_READ|PROT_WRITE;
+		if (mmap(Base,          Page+S, RW, MAP_SHARED|MAP_FIXED, FD, Off)      == MAP_FAILED or
+			mmap(Base+Page+S,   S,      RW, MAP_SHARED|MAP_FIXED, FD, Off+Page) == MAP_FAILED) {
+			munmap(Base, Total);
+			return nullptr;
+		}
+		auto Rz = (PicoBuff*)(Base + Page - offsetof(PicoBuff, Data));
+		Rz->MapSize = Total;
+		Rz->Size = S;
+		return Rz;
+	}
 
 	void Log (const char* Src, int Length) {
+		(void)Src; (void)Length;
 //	#ifdef PICO_DEBUG_LOG
 //		if (FDLog > 0) {
 //			char Tmp[32*1024]; // increase this yourself if using PICO_DEBUG_LOG
@@ -332,20 +986,23 @@ struct PicoBuff {
 	void lost (int N) {
 		pico_global_conf.LastActivity = PicoNow();
 		Tail += N;
+		if (Waiters)
+			pico_futex_wake(&Tail);
 	}
 
 	void gained (int N) { 
 		Head += N;
 	} ;;;/*_*/;;;
 	
-	void send_sub (const char* Src, int Need) {
+	void send_sub (const char* Src, int Need, bool Last=true) {
 		while (auto Dest = AskUnused()) {
 			int Avail = std::min(Need, Dest.Length);
 			memcpy(Dest.Data, Src, Avail);
-			gained(Avail + (-Avail&3));
 			Need -= Avail;
 			Src += Avail;
-			if (Need <= 0) return;
+			if (Need <= 0) // pad only at the very end, so pieces can be joined.
+				return gained(Avail + (Last ? (-(Head+Avail))&3 : 0));
+			gained(Avail);
 		};
 	}
 	
@@ -356,13 +1013,22 @@ struct PicoBuff {
 //			close(self->FDLog);
 //		}
 //	#endif
-		if (self and --(self->RefCount) == 0)
+		if (!self or (!self->Shared and --(self->RefCount) != 0))
+			return;
+		Decr(self->Older);
+		if (int M = self->MapSize)
+			munmap(self->Data - (M - 2*self->Size), M);
+		  else if (int P = self->PlainMap)
+			munmap(self, P);
+		  else
 			free(self);
 	}
 		
 	PicoMessage AskUsed () {
 		int T = Tail; int H = Head; int S = Size; int B = S - 1;
-		if (T >= H) return {};
+		int L = H - T;
+		if (L <= 0) return {};
+		if (MapSize) return {Data+(T&B), L}; // mirrored
 		T &= B; H &= B; // 🕷️ _ 🕷️
 		if (T >= H) // tail to head... or to size
 			H = S;
@@ -373,6 +1039,7 @@ struct PicoBuff {
 		int T = Tail; int H = Head; int S = Size; int B = S-1;
 		int L = H - T;
 		if (L >= S) return {};
+		if (MapSize) return {Data+(H&B), S-L};
 		T &= B; H &= B;
 		if (T > H) // head to size, or head to tail.
 			S = T;
@@ -383,10 +1050,62 @@ struct PicoBuff {
 		return Head - Tail;
 	}  										;;;/*_*/;;;
 	
-	PicoDate SendOutput (const char* Src, int MsgLen) {
+	void Note () {
+		int L = Length();
+		if (L > Peak) Peak = L;
+	}
+	
+	bool Idle () { // Called 4x a second. Mostly empty for 2 seconds?
+		Quiet = (Peak < Size/8) ? std::min(Quiet+1, 255) : 0;
+		Peak = Length();
+		return Quiet >= 8;
+	}
+	
+	void CopyFrom (PicoBuff* Old) { // Fresh buffer takes `Old`'s contents. Keeps the same alignment, so padding still lines up.
+		Tail = Head = Old->Tail & 3;
+		iovec V[2];
+		int n = Old->Parts(V, true);
+		for (int i = 0; i < n; i++) {
+			auto Src = (const char*)V[i].iov_base;
+			int Need = (int)V[i].iov_len;
+			while (Need > 0) {
+				auto Dest = AskUnused();
+				int Avail = std::min(Need, Dest.Length);
+				memcpy(Dest.Data, Src, Avail);
+				gained(Avail);
+				Src += Avail; Need -= Avail;
+			}
+		}
+	}
+	
+	int Parts (iovec* V, bool Used) { // Like `AskUsed()`/`AskUnused()`, but both pieces either side of the wrap.
+		unsigned int T = Tail; unsigned int H = Head; int S = Size;
+		int L = Used ? (int)(H - T) : S - (int)(H - T);
+		if (L <= 0 or L > S) return 0;
+		int P = (Used ? T : H) & (S-1);
+		int First = MapSize ? L : std::min(L, S - P);
+		V[0] = {Data+P, (size_t)First};
+		if (First == L) return 1;
+		V[1] = {Data, (size_t)(L-First)};
+		return 2;
+	}
+	
+	static int Framed (int MsgLen) {
+		return MsgLen + PicoMsgInfo + (-MsgLen&3);
+	}
+	
+	int Unused () {
+		return Size - Length();
+	}
+	
+	bool CanFit (int MsgLen) {
+		return Unused() >= Framed(MsgLen);
+	}
+	
+	PicoDate SendOutput (const char* Src, int MsgLen, int Flags=0) {
 //		this->Log(Src, MsgLen); // So I can search -> Log and get all.
-		int NetLen = letoh(MsgLen);
-		if (Size - Length() >= MsgLen+PicoMsgInfo) {
+		int NetLen = letoh(MsgLen|Flags);
+		if (CanFit(MsgLen)) {
 			send_sub((char*)&NetLen, PicoMsgInfo);
 			send_sub(Src, MsgLen);
 			return pico_global_conf.LastActivity = PicoNow();
@@ -394,15 +1113,44 @@ struct PicoBuff {
 		return 0;
 	}
 	
+	PicoDate SendOutputV (const iovec* Parts, int Count, int MsgLen, int Flags=0) {
+		int NetLen = letoh(MsgLen|Flags);
+		if (!CanFit(MsgLen)) return 0;
+		send_sub((char*)&NetLen, PicoMsgInfo);
+		for (int i = 0; i < Count; i++)
+			send_sub((const char*)Parts[i].iov_base, (int)Parts[i].iov_len, i == Count-1);
+		return pico_global_conf.LastActivity = PicoNow();
+	}
+	
+	char* Reserve (int MsgLen) { // space after the header, if contiguous
+		int Pos = (Head + PicoMsgInfo) & (Size-1);
+		if (MapSize or Pos + MsgLen <= Size)
+			return Data + Pos;
+		return nullptr;
+	}
+	
+	PicoDate Commit (int MsgLen) { // publish a message written into `Reserve()`
+		*((int*)(Data + (Head&(Size-1)))) = letoh(MsgLen);
+		gained(Framed(MsgLen));
+		return pico_global_conf.LastActivity = PicoNow();
+	}
+	
 	/*	
 		* Can save 8*64 bytes by merge all buffs into one. Still need 4 ints.
 	*/
 
+	int PeekLength (unsigned int Pos) {
+		return *((int*)(Data+(Pos&(Size-1))));
+	}
+	
+	int PeekLength () {
+		return PeekLength(Tail);
+	}
+
 	int ReadLength () {
 		int N = Length();
 		if (N >= 4) {
-			int T = Tail&(Size-1);
-			int D = *((int*)(Data+T));
+			int D = PeekLength();
 			lost(4);
 			return D;
 		}
@@ -428,10 +1176,232 @@ struct PicoBuff {
 
 
 
+struct PicoQueue { // Single-producer (whoever holds GrabLock), single-consumer (the user). Holds grabbed messages.
+	PicoMessage			Items[1024];
+	int64_t				Sent[1024];		// With `PicoTimedMsgs`: when each was sent, in ns. 0 = not timed.
+	std::atomic_uint	Head;
+	std::atomic_uint	Tail;
+	std::atomic_int		Bytes;
+	
+	bool Full (int Limit) {
+		int N = Head - Tail;
+		return N >= 1024 or (N and Bytes >= Limit);
+	}
+	
+	bool Any () {
+		return Head != Tail;
+	}
+	
+	PicoMessage& Front () {
+		return Items[Tail & 1023];
+	}
+	
+	int64_t FrontSent () {
+		return Sent[Tail & 1023];
+	}
+	
+	void Push (PicoMessage M, int64_t When=0) {
+		Sent[Head & 1023] = When;
+		Items[Head & 1023] = M;
+		Bytes += M.Length;
+		Head++;
+	}
+	
+	PicoMessage Pop () {
+		if (!Any()) return {};
+		PicoMessage M = Front();
+		Bytes -= M.Length;
+		Tail++;
+		return M;
+	}
+	
+	static void Free (PicoQueue* Q) {
+		if (!Q) return;
+		while (Q->Any())
+			free(Q->Pop().Data);
+		free(Q);
+	}
+};
+
+
+
+struct PicoLatency { // Send-to-get delays, in ns. HDR-style: 8 buckets per doubling, so within 12.5%.
+	std::atomic_uint		Counts[312];	// up to 2^40ns, about 18 minutes.
+	std::atomic_uint		Total;
+	std::atomic_uint64_t	Max;
+	
+	static int Bucket (uint64_t ns) {
+		ns = std::min(ns, (uint64_t)1 << 40);
+		if (ns < 8) return (int)ns;
+		int b = pico_log2(ns);
+		return std::min((b-2)*8 + (int)((ns >> (b-3)) & 7), 311);
+	}
+	
+	static double Middle (int i) {		// the value a bucket stands for.
+		if (i < 8) return i;
+		int b = i/8 + 2;
+		uint64_t Low = (uint64_t)(8 + (i & 7)) << (b-3);
+		return Low + ((uint64_t)1 << (b-3)) * 0.5;
+	}
+	
+	void Note (int64_t ns) {			// only the reader calls this.
+		ns = std::max(ns, (int64_t)0);	// different processes, so clocks might disagree a little.
+		Counts[Bucket(ns)]++;
+		Total++;
+		if ((uint64_t)ns > Max) Max = ns;
+	}
+	
+	static void Stats (PicoLatency* L, PicoLatencyStats* S, bool Reset) {
+		*S = {};
+		if (!L) return;
+		unsigned int Seen[312];
+		unsigned int N = 0;
+		for (int i = 0; i < 312; i++)
+			N += (Seen[i] = Reset ? L->Counts[i].exchange(0) : L->Counts[i].load());
+		S->Count = N;
+		S->Max = (Reset ? L->Max.exchange(0) : L->Max.load()) * 0.001f;
+		if (Reset) L->Total = 0;
+		if (!N) return;
+		float* Out[3] = {&S->P50, &S->P99, &S->P999};
+		double Want[3] = {0.5, 0.99, 0.999};
+		unsigned int Sum = 0;
+		for (int i = 0, k = 0; i < 312 and k < 3; i++) {
+			Sum += Seen[i];
+			while (k < 3 and Sum >= Want[k] * N)
+				*Out[k++] = std::min(Middle(i) * 0.001, (double)S->Max);
+		}
+	}
+};
+
+
+struct PicoBlock {		// Sits before each pooled message.
+	union {
+		PicoBlock*		Next;			// while it's in the pool.
+		PicoMsgPool*	Owner;			// while it's lent out.
+	};
+	int					Class;			// -1 = not pooled. Just `free()` it.
+	int					Unused;
+};
+
+
+struct PicoMsgPool { // Recycles received messages, in size-classes of 64B to 64KB.
+	// Only the grabber (whoever holds GrabLock) takes blocks out, so the free-lists can't suffer from ABA.
+	static const int	Classes = 11;
+	std::atomic<PicoBlock*>	Lists[Classes];
+	std::atomic_int		Cached[Classes];
+	std::atomic_uint	Hits;
+	std::atomic_uint	Misses;
+	std::atomic_uint	TooBig;
+	std::atomic_int		Refs;			// the comm, plus each block lent out. The last one frees the pool.
+	std::atomic_bool	Orphan;			// the comm is gone. Blocks that come back get freed.
+	
+	static int ClassOf (int n) {
+		return n <= 64 ? 0 : pico_log2(n-1) - 5;
+	}
+	
+	static int Cap (int c) { // up to 1MB per class, but always a few.
+		return std::max(16, (1<<20) >> (c+6));
+	}
+	
+	char* Alloc (int n) {
+		int c = ClassOf(n+1);
+		PicoBlock* B = nullptr;
+		if (c >= Classes) {
+			TooBig++;
+			if ((B = (PicoBlock*)malloc(sizeof(PicoBlock) + n + 1)))
+				B->Class = -1;
+		} else {
+			B = Lists[c];
+			while (B and !Lists[c].compare_exchange_weak(B, B->Next))
+				;
+			if (B) {
+				Cached[c]--;
+				Hits++;
+			} else {
+				Misses++;
+				if ((B = (PicoBlock*)malloc(sizeof(PicoBlock) + (64<<c))))
+					B->Class = c;
+			}
+		}
+		if (!B) return nullptr;
+		Refs++;
+		B->Owner = this;
+		char* Data = (char*)(B+1);
+		Data[n] = 0;
+		return Data;
+	}
+	
+	static PicoMsgPool* New () {
+		auto P = (PicoMsgPool*)calloc(1, sizeof(PicoMsgPool));
+		if (P) P->Refs = 1;
+		return P;
+	}
+	
+	static void Free (char* Data) { // the block knows its pool. So this works even after the comm is gone.
+		if (!Data) return;
+		auto B = ((PicoBlock*)Data) - 1;
+		auto P = B->Owner;
+		int c = B->Class;
+		if (!P or c < 0 or P->Orphan or P->Cached[c] >= Cap(c)) {
+			free(B);
+		} else {
+			P->Cached[c]++;
+			B->Next = P->Lists[c];
+			while (!P->Lists[c].compare_exchange_weak(B->Next, B))
+				;
+		}
+		if (P) Release(P);
+	}
+	
+	static void Unpooled (PicoMsgPool* P, char* Base) { // a joined message, that was malloc'ed with room for a header.
+		auto B = (PicoBlock*)Base;
+		B->Class = -1;
+		B->Owner = P;
+		if (P) {P->TooBig++; P->Refs++;}
+	}
+	
+	void Empty () {
+		for (auto& L : Lists) {
+			auto B = L.exchange(nullptr);
+			while (B) {
+				auto Next = B->Next;
+				free(B);
+				B = Next;
+			}
+		}
+	}
+	
+	static void Release (PicoMsgPool* P) {
+		if (--P->Refs > 0) return;
+		P->Empty();
+		free(P);
+	}
+	
+	static void Detach (PicoMsgPool* P) { // the comm is going. Lent blocks keep the pool alive, till they come back.
+		if (!P) return;
+		P->Orphan = true;
+		P->Empty();
+		Release(P);
+	}
+	
+	void Stats (PicoPoolStats* S) {
+		S->Hits = Hits; S->Misses = Misses; S->TooBig = TooBig;
+		S->CachedBytes = 0;
+		for (int c = 0; c < Classes; c++)
+			S->CachedBytes += Cached[c] * (64<<c);
+		unsigned int All = S->Hits + S->Misses + S->TooBig;
+		S->HitRate = All ? (float)S->Hits / All : 0;
+	}
+};
+
+
+
 struct PicoComms : PicoConfig {
 	static PicoComms* New (PicoComms* M, int noise, bool isparent, int size, const char* name, int ID) {
-		M = (PicoComms*)&pico_all[--ID];
-		return M->Init(noise, isparent, size, name);
+		M = (PicoComms*)pico_list.At(--ID);
+		M->Init(noise, isparent, size, name);
+		pico_list.Show(ID);
+		return M;
 	}
 	
 	PicoComms* Init (int noise, bool isparent, int size, const char* name) { // constructor
@@ -450,28 +1420,81 @@ struct PicoComms : PicoConfig {
 
 		B += ((1<<B) < size);
 		Bits = B;
+		UnreadLimit = (int)std::min(8LL << B, (long long)INT32_MAX);
+		MinBuffSize = 1<<14;
+		MaxBuffSize = 1<<std::min(B+4, 30);
+		PackAbove = 256;
+		SendDelay = 200;
 		
 		if (!name) name = "";
 		strncpy(Name, name, sizeof(Name)-1);
 		return this;
 	} ;;;/*_*/;;;
 	
-	void Destroy () {
-		free(PreData);
+	void Stats (PicoCommStats* S) {
+		auto& C = Counts;
+		S->MsgsSent		= C.MsgsSent;
+		S->MsgsGot		= C.MsgsGot;
+		S->BytesSent	= C.BytesSent;
+		S->BytesGot		= C.BytesGot;
+		S->SendCalls	= C.SendCalls;
+		S->ReadCalls	= C.ReadCalls;
+		S->Again		= C.Again;
+		S->BufferFull	= C.BufferFull;
+		S->BlockedTime	= C.BlockedNS * 0.000000001;
+		S->SendingPeak	= C.SendingPeak;
+		S->ReadingPeak	= C.ReadingPeak;
+	}
+	
+	static void AddStats (PicoCommStats* To, const PicoCommStats& S) {
+		To->MsgsSent	+= S.MsgsSent;
+		To->MsgsGot		+= S.MsgsGot;
+		To->BytesSent	+= S.BytesSent;
+		To->BytesGot	+= S.BytesGot;
+		To->SendCalls	+= S.SendCalls;
+		To->ReadCalls	+= S.ReadCalls;
+		To->Again		+= S.Again;
+		To->BufferFull	+= S.BufferFull;
+		To->BlockedTime	+= S.BlockedTime;
+		To->SendingPeak	= std::max(To->SendingPeak, S.SendingPeak);
+		To->ReadingPeak	= std::max(To->ReadingPeak, S.ReadingPeak);
+	}
+	
+	bool Destroy () {
+		int ID = pico_list.IndexOf(this);
+		if (!pico_list.Hide(ID))				// a sweep from before we were hidden. Someone else is on it.
+			return false;
+		PicoCommStats Final; Stats(&Final);		// so `PicoGlobals()` still counts us.
+		pico_dead_lock.lock();
+		AddStats(&pico_dead_stats, Final);
+		pico_dead_lock.leave();
+		while (queued())
+			msg_free(pop(false).Data);
+		PicoQueue::Free(Unread);
+		PicoMsgPool::Detach(Pool);
+		free(Latency);
+		free(Partial);
+		free(Packing);
+		PicoBuff::Decr(Retired[0]);
+		PicoBuff::Decr(Retired[1]);
+		if (ReserveCopy) free(Reserved);
 		if (Socket > 0)
 			msg_close_for_real(Socket);
 		PicoBuff::Decr(Sending);
 		PicoBuff::Decr(Reading);
 		PicoBuff::Decr(StdErr );
 		PicoBuff::Decr(StdOut );
+		free(Ops);
+		if (Worker) pico_workers[Worker-1].Comms--;
 		if (CanSayDebug()) Say("Deleted");
-		memset(this, 0, sizeof(PicoComms));
-		auto ID = this - (PicoComms*)(&pico_all[0]);
+		memset((void*)this, 0, sizeof(PicoComms));
 		pico_list.Remove(ID);
+		return true;
 	}
 
 	/// **Class Initialisation Helpers**
 	bool MiniPipe (int Pipe[2], int Mode, int Std) {
+		(void)Std;
 		if (Mode >= 1)
 			return true;
 
@@ -526,7 +1549,7 @@ struct PicoComms : PicoConfig {
 				sclose(STDOUT_FILENO);
 			if (NoStdErr == 1) 
 				sclose(STDERR_FILENO);
-			pico_thread_count = 0;
+			pico_forked();
 			ChildClosePipes(Out, STDOUT_FILENO);
 			ChildClosePipes(Err, STDERR_FILENO);
 			return 0;
@@ -537,16 +1560,18 @@ struct PicoComms : PicoConfig {
 		
 		if (!NoStdOut) {
 			close(Out[1]);
-			StdOut = PicoBuff::New(18, "StdOut", this, Out[0]);
+			StdOut = PicoBuff::New(18, "StdOut", this, Out[0], false, buff_node());
 			if (StdOut)
 				PartClosed &=~ 4;
+			watch(Out[0]);
 		}
 		
 		if (!NoStdErr) {
 			close(Err[1]);
-			StdErr = PicoBuff::New(16, "StdErr", this, Err[0]);
+			StdErr = PicoBuff::New(16, "StdErr", this, Err[0], false, buff_node());
 			if (StdErr)
 				PartClosed &=~ 8;
+			watch(Err[0]);
 		}
 		
 		PID = ChildID;
@@ -562,6 +1587,8 @@ struct PicoComms : PicoConfig {
 		
 		PicoComms* C = PicoComms::New(nullptr, Noise, false, 1<<Bits, "Thread", ChildID);
 		Socket = -1;  C->Socket = -1;
+		C->Worker = Worker;			// one worker for both sides. No socket, so only `sent()` can wake the reader's worker.
+		if (Worker) pico_workers[Worker-1].Comms++;
 		Sending->RefCount++;     Reading->RefCount++; 
 		C->Sending = Reading; C->Reading = Sending;
 		C->PartClosed = PartClosed;
@@ -588,6 +1615,7 @@ struct PicoComms : PicoConfig {
 		if (!PairID) {GiveUp(Socks); return nullptr;}
 		
 		PicoComms* Rz = PicoComms::New(nullptr, Noise, false, 1<<Bits, "Pair", PairID);
+		Rz->Options = Options;
 		add_msg_buffs(Socks[0]);
 		Rz->add_msg_buffs(Socks[1]);
 		return Rz;
@@ -600,12 +1628,14 @@ struct PicoComms : PicoConfig {
 
 	bool RestoreExec () {
 		ExecFlags |= PicoExecForked;
+		restore_shared();
 		return StartSocket(FindSock()); 
 	}
 	
 	pid_t StartFork (const char* ChildName, bool SaveSocket) {
 		int Socks[2] = {};
 		if (!get_pair_of(Socks)) return -errno;
+		int Shm = (Options&PicoSharedMem) ? share_msg_buffs(SaveSocket) : -1;
 		pid_t childid = fork();
 		if (childid < 0) return GiveUp(Socks);
 
@@ -615,12 +1645,16 @@ struct PicoComms : PicoConfig {
 		int S = Socks[IsParent];
 		if (!IsParent) {
 			if (ChildName)
-				strncpy(Name, ChildName, sizeof(Name));
-			pico_thread_count = 0; // Forked process don't keep threads.
+				strncpy(Name, ChildName, sizeof(Name)-1);
+			pico_forked(); // Forked process don't keep threads.
+			if (Shm >= 0)
+				std::swap(Sending, Reading);
 			if (SaveSocket)
-				return StoreSock(S);
+				return StoreSock(S, Shm);
 		} 
 		
+		if (Shm >= 0)
+			close(Shm);
 		PID = childid;
 		add_msg_buffs(S);
 		return PID; 
@@ -653,36 +1687,134 @@ struct PicoComms : PicoConfig {
 		return C;
 	}
 	
-	pid_t StoreSock (int Succ) {
+	pid_t StoreSock (int Succ, int Shm) {
 		char Data[8]; TextNumber(Succ, Data);
 		setenv("__PicoSock__", Data, 1);
+		if (Shm >= 0) {
+			char Both[16]; int n = TextNumber(Shm, Both);
+			Both[n] = ','; TextNumber(Bits, Both+n+1);
+			setenv("__PicoShm__", Both, 1);
+		}
 		return 0;
 	}
+	
+	void restore_shared () {
+		const char* x = getenv("__PicoShm__");
+		if (!x) return;
+		int FD = std::atoi(x);
+		const char* B = strchr(x, ',');
+		unsetenv("__PicoShm__");
+		if (B and !Sending and !Reading and map_shared(FD, std::atoi(B+1), false))
+			Options |= PicoSharedMem;
+		close(FD);
+	}
+	
+	int share_msg_buffs (bool Inherit) {
+		int Page = (int)sysconf(_SC_PAGESIZE);
+		int FD = -1;
+		if (!Sending and !Reading)
+			FD = pico_memfd(2*(Page + (1<<Bits)), Inherit);
+		if (FD >= 0 and map_shared(FD, Bits, true))
+			return FD;
+		if (FD >= 0) close(FD);
+		Options &= ~PicoSharedMem;							// just use the socket then.
+		return -1;
+	}
+	
+	bool map_shared (int FD, int bits, bool Creator) {
+		// Both buffers live in one memfd, so the other process can map them too. Only wake-ups go through the socket.
+		if (bits < 14 or bits > 30) return false;
+		int Page = (int)sysconf(_SC_PAGESIZE); int S = 1<<bits;
+		auto A = PicoBuff::Map(FD, 0,      S, Page);
+		auto B = PicoBuff::Map(FD, Page+S, S, Page);
+		if (!A or !B) {
+			if (A) {A->Shared = true; PicoBuff::Decr(A);}
+			if (B) {B->Shared = true; PicoBuff::Decr(B);}
+			return false;
+		}
+		if (Creator) {
+			A->Init(bits, "Send", -1);
+			B->Init(bits, "Read", -1);
+			A->Shared = true; B->Shared = true;
+		}
+		Bits = bits;
+		Sending = Creator ? A : B;
+		Reading = Creator ? B : A;
+		Notified = Sending->Head;
+		return true;
+	}
 
 	bool CanGet () {
-		return !(PartClosed & 2) or PreData;
+		return !(PartClosed & 2) or queued();
 	}
 	
 	bool StillSending () {
-		return !(PartClosed & 1) and Sending->Length() > 0;	
+		if (PartClosed & 1) return false;
+		if (Options & PicoSharedMem)						// the other side already has the data.
+			return Sending->Head != Notified;
+		return Sending->Length() > 0;
 	}
 	
 	bool QueueSend (const char* msg, int n, int Policy) {
+		return counted(queue_send(msg, n, Policy), n);
+	}
+	
+	bool queue_send (const char* msg, int n, int Policy) {
 		if (!msg or n < 0 or PartClosed&1 or !Sending) return false; //
+		iovec V = {(void*)msg, (size_t)n};
+		if (Options & PicoTimedMsgs)
+			return send_stamped(&V, 1, n, Policy);
+		if (packs(n))
+			if (int R = send_packed(&V, 1, n, Policy); R >= 0) return R;
+		if (Sending->Shrink) adapt_send(-1);
 		if (queue_sub(msg, n)) return true;
-		if (n+PicoMsgInfo > Sending->Size)
-			return SayEvent("CantSend: Message too large!");
-		if (Policy == PicoSendGiveUp)
-			return (!SendFailCount++) and SayEvent("CantSend: BufferFull");
-		
-		PicoDate Final = PicoNow() + (PicoDate)(SendTimeOut*65536.0f);
-		while (PicoNow() < Final) {
-			if (PartClosed&1) return false; // closed!
-			sched_yield();
-			if (queue_sub(msg, n)) return true;
+		if (adapt_send(n) and queue_sub(msg, n)) return true;
+		if (n > Sending->Size - PicoMsgInfo or n >= PicoStamped)
+			return send_pieces(&V, 1, n, Policy);
+		return wait_for_space(n, Policy) and queue_sub(msg, n);
+	}
+	
+	char* SendReserve (int n, int Policy) {
+		if (Reserved or n < 0 or n >= PicoStamped or PartClosed&1 or !Sending) return nullptr;
+		if (Sending->Shrink) adapt_send(-1);
+		if (!Sending->CanFit(n) and !adapt_send(n)) {
+			if (n > Sending->Size - PicoMsgInfo)			// would never fit, so don't wait for it.
+				return (char*)SayEvent("CantReserve: Message bigger than the send-buffer!");
+			if (!wait_for_space(n, Policy)) return nullptr;
 		}
-		
-		return (!SendFailCount++) and SayEvent("CantSend: TimedOut");
+		ReserveMax = n;
+		ReserveCopy = false;
+		if ((Reserved = Sending->Reserve(n)))
+			return Reserved;
+		ReserveCopy = true;									// wraps around, so use a temp buffer.
+		if (!(Reserved = phalloc(n)))
+			fail_alloc();
+		return Reserved;
+	}
+	
+	bool SendCommit (int n) {
+		char* R = Reserved;
+		if (!R) return false;
+		Reserved = nullptr;
+		bool OK = n >= 0 and n <= ReserveMax and !(PartClosed&1);
+		if (ReserveCopy) {
+			OK = OK and queue_sub(R, n);
+			free(R);
+			return counted(OK, n);
+		}
+		return counted(OK and sent(Sending->Commit(n)), n);
+	}
+	
+	bool QueueSendV (const iovec* Parts, int Count, int Policy) {
+		if (!Parts or Count < 0 or PartClosed&1 or !Sending) return false;
+		int64_t n = 0;
+		for (int i = 0; i < Count; i++)
+			n += Parts[i].iov_len;
+		if (n > INT32_MAX - 8) // also catches overflows
+			return SayEvent("CantSend: Message too large!");
+		if (Options & PicoTimedMsgs)
+			return counted(send_stamped(Parts, Count, n, Policy), n);
+		return counted(send_flagged(Parts, Count, n, Policy, 0), n);
 	}
 	
 	PicoMessage GetStd (PicoAppenderFn Fn, void* Obj, PicoBuff* B) {
@@ -692,6 +1824,7 @@ struct PicoComms : PicoConfig {
 				char* Dest = Fn ? (Fn)(Obj, L) : phalloc(L);
 				if (Dest) {
 					B->ReadInput(Dest, L);
+					unstall();
 					return {Dest, L};
 				}
 				fail_alloc();
@@ -709,14 +1842,135 @@ struct PicoComms : PicoConfig {
 	}
 	
 	PicoMessage Get (float T = 0.0) {
-		if (!PreData and !pre_grab())
+		if (!ViewLength) ZeroCopy = false;				// back to copying them out in the background.
+		if (!queued() and !pre_grab())
 			if (!T or !delay_read(T))
 				return {};
+		return pop();
+	}
+	
+	int GetMany (PicoMessage* Out, int Max, float T) {
+		if (Max <= 0 or !Reading or ViewLength) return 0;
+		ZeroCopy = false;
+		if (!has_msg() and !(T and delay_read(T, true))) return 0;
 		
-		PicoMessage M = {PreData, PreLength};
-		PreLength = 0;	// could this have sync errors?
-		PreData = 0;	// we are setting two values, and we have to assume things can get out of sync.
-		return M;		// but will that cause a problem or not?
+		GrabLock.lock();
+		int N = 0; int Total = 0; int NQ = 0;
+		auto Q = Unread.load();
+		while (true) {
+			if (Q) for (unsigned int i = Q->Tail; i != Q->Head and N < Max; i++) {	// already grabbed ones first
+				N++; Total += Q->Items[i & 1023].Length + 1;
+			}
+			NQ = N;
+			
+			int Avail = Partial ? 0 : Reading->Length();	// pieces get joined by `pre_grab_sub()`.
+			unsigned int Pos = Reading->Tail;
+			if (int L = PreLength; L and N < Max) {			// header already read
+				if (L < 0 or (L & PicoFlags) or Avail < L) {
+					Avail = 0;
+				} else {
+					N++; Total += L + 1;
+					Pos += L + (-L&3); Avail -= L + (-L&3);
+				}
+			}
+			
+			while (N < Max and Avail >= PicoMsgInfo) {		// count up all the whole messages
+				int L = htole(Reading->PeekLength(Pos));
+				if (L <= 0 or (L & PicoFlags) or Reading->Size < L + PicoMsgInfo or Avail < L + PicoMsgInfo)
+					break;
+				N++; Total += L + 1;
+				Pos += PicoBuff::Framed(L); Avail -= PicoBuff::Framed(L);
+			}
+			if (N) break;
+			
+			bool OK = pre_grab_sub();						// packed, stamped or in pieces. Those get copied out first. (Or it reports the problem.)
+			Q = Unread.load();
+			if (!OK or !Q or !Q->Any()) {
+				GrabLock.leave();
+				return 0;
+			}
+		}
+		
+		char* Block = msg_alloc(Total-1);
+		if (!Block) {
+			GrabLock.leave();
+			*Out = Get();
+			return Out->Data ? 1 : 0;
+		}
+		
+		char* Dest = Block;
+		for (int i = 0; i < N; i++) {						// now copy them, all into one block.
+			int L = PreLength;
+			if (i < NQ) {
+				note_latency(Q);
+				auto M = Q->Pop();
+				L = M.Length;
+				memcpy(Dest, M.Data, L);
+				msg_free(M.Data);
+			} else {
+				if (!L)
+					L = htole(Reading->ReadLength());
+				Reading->ReadInput4(Dest, L);
+				PreLength = 0;
+				got_bytes(L);
+			}
+			Dest[L] = 0;
+			Out[i] = {Dest, L};
+			Dest += L + 1;
+		}
+		LastRead = PicoNow();
+		GrabLock.leave();
+		unstall();
+		return N;
+	}
+	
+	PicoMessage GetView (float T = 0.0) {
+		if (ViewLength or !Reading) return {};			// must release first.
+		ZeroCopy = true;
+		PicoMessage M = view_sub();
+		if (!M and T and delay_read(T, true))
+			M = view_sub();
+		return M;
+	}
+	
+	PicoMessage GetAppend (PicoAppenderFn Fn, void* Obj, float T, int* Need) {
+		int Unused = 0;
+		if (!Need) Need = &Unused;
+		*Need = 0;
+		if (!Fn or ViewLength or !Reading) return {};
+		PicoMessage M = append_sub(Fn, Obj, Need);
+		if (!M and !*Need and T and delay_read(T, true))
+			M = append_sub(Fn, Obj, Need);
+		return M;
+	}
+	
+	struct IntoBuff {char* Buf; int Cap;};
+	static char* into_fn (void* Obj, int Length) {
+		auto I = (IntoBuff*)Obj;
+		return Length <= I->Cap ? I->Buf : nullptr;
+	}
+	
+	int GetInto (char* Buf, int Cap, float T) {
+		IntoBuff I = {Buf, Buf ? std::max(Cap, 0) : 0};
+		int Need = 0;
+		auto M = GetAppend(into_fn, &I, T, &Need);
+		if (!M) return -Need;
+		if (M.Length < Cap) Buf[M.Length] = 0;
+		return M.Length;
+	}
+	
+	void Release () {
+		int V = ViewLength;
+		if (!V) return;
+		ViewLength = 0;
+		if (V < 0) {									// was copied after all
+			msg_free(pop(false).Data);
+			return;
+		}
+		Reading->lost(V);
+		PreLength = 0;
+		GrabLock.leave();
+		unstall();
 	}
 	
 	void* SayEvent (const char* A, const char* B="", int Iter=0) {
@@ -771,6 +2025,9 @@ struct PicoComms : PicoConfig {
 		PartClosed |= 15;
 		if (!SocketStatus) SocketStatus = ENOTCONN;
 		if (CanSayDebug()) Say("AskClose", Why);
+		got_msg();
+		wake_senders();
+		pico_wake(Worker);
 	}
 	
 	void AskDestroy (const char* Why) {
@@ -778,100 +2035,811 @@ struct PicoComms : PicoConfig {
 		//if (!DestroyMe)
 		KeepAlive = false;
 	}
-
-
-
-/// ** INTERNALS **	
-	static void* pico_thread_root (void* C_) {
-		auto C = (PicoComms*)C_;
-		auto S = C->Sending;
-		auto R = C->Reading;
-		auto fn = (PicoThreadFn)(S->ThreadArgs);
-		auto Args = (const char**)R->ThreadArgs;
-		auto Mode = R->ThreadMode;
-		S->ThreadArgs = 0; R->ThreadArgs = 0;
-		(fn)(C, Mode, Args);
-		C->AskDestroy("ThreadCompleted");
-		return 0;
+
+
+
+/// ** INTERNALS **	
+	static void* pico_thread_root (void* C_) {
+		auto C = (PicoComms*)C_;
+		auto S = C->Sending;
+		auto R = C->Reading;
+		auto fn = (PicoThreadFn)(S->ThreadArgs);
+		auto Args = (const char**)R->ThreadArgs;
+		auto Mode = R->ThreadMode;
+		S->ThreadArgs = 0; R->ThreadArgs = 0;
+		(fn)(C, Mode, Args);
+		C->AskDestroy("ThreadCompleted");
+		return 0;
+	}
+	
+	bool queue_sub (const char* msg, int n) {
+		return Sending and n < PicoStamped and sent(Sending->SendOutput(msg, n));
+	}
+	
+	bool counted (bool OK, int64_t n) {
+		if (OK) {
+			PicoCounters::Add(Counts.MsgsSent);
+			PicoCounters::Add(Counts.BytesSent, n);
+		}
+		return OK;
+	}
+	
+	void got_bytes (int L) {
+		PicoCounters::Add(Counts.MsgsGot);
+		PicoCounters::Add(Counts.BytesGot, L);
+	}
+	
+	bool sent (PicoDate D) {
+		if (!D) return false;
+		Sending->Note();
+		PicoCounters::Peak(Counts.SendingPeak, Sending->Length());
+		if (Socket < 0) LastSend = D; // threaded
+		if (!hold_send(D))
+			pico_wake(Worker);
+		return true;
+	}
+	
+	PicoDate send_delay () {
+		return std::max((PicoDate)SendDelay * 65536 / 1000000, (PicoDate)1);
+	}
+	
+	bool hold_send (PicoDate Now) {
+		// Coalescing, for the sender. Small amounts wait for more to come, so the worker makes fewer syscalls.
+		if (SendBatch <= 0 or Socket <= 0 or FlushNow) return false;
+		int N = Sending->Length();
+		if (N >= SendBatch or N >= Sending->Size/2) return false;
+		PicoDate Zero = 0;
+		HeldSince.compare_exchange_strong(Zero, Now);
+		pico_flush_by(Worker, (Zero ? Zero : Now) + send_delay());	// wakes the worker by the deadline.
+		return true;
+	}
+	
+	bool holding () {
+		// Coalescing, for the worker. Keeps holding until there is a batch, or the deadline passes.
+		if (SendBatch <= 0 or FlushNow) return false;
+		int N = Sending->Length();
+		if (!N or N >= SendBatch or N >= Sending->Size/2 or Sending->Waiters) return false;
+		PicoDate H = 0;
+		if (HeldSince.compare_exchange_strong(H, PicoNow()))	// we saw the bytes before the sender marked them.
+			H = HeldSince;
+		if (PicoNow() >= H + send_delay()) return false;
+		pico_flush_by(Worker, H + send_delay());
+		return true;
+	}
+	
+	void Flush () {
+		if (!Sending or !Sending->Length()) return;
+		FlushNow = true;
+		pico_wake(Worker);
+	}
+	
+	void read_part (PicoBuff* B, int S, int Part) {
+		iovec V[2];
+		if (S >= 0) while ( int n = B->Parts(V, false) ) {
+			int Amount = 0;
+			int Want = (int)(V[0].iov_len + (n > 1 ? V[1].iov_len : 0));
+			if (Part > 2) {
+				Amount = (int) readv(S, V, n);
+			} else { // maybe nicer to avoid sockets and just use pipes. Simpler and more flexible.
+			       // and can still use sockets.
+				msghdr Msg = {};
+				Msg.msg_iov = V; Msg.msg_iovlen = n;
+				Amount = (int) recvmsg(S, &Msg, MSG_NOSIGNAL|MSG_DONTWAIT);
+				PicoCounters::Add(Counts.ReadCalls);
+			}
+			if (Amount <= 0) {
+				if (!io_pass(Amount, Part)) break;
+				continue;
+			}
+//			B->Log(Msg.Data, Amount);
+			pico_timeout_count = 0;			// reset
+			B->gained(Amount);
+			B->Note();
+			Traffic += Amount;
+			if (B == Reading) PicoCounters::Peak(Counts.ReadingPeak, B->Length());
+			if (CanSayDebug()) Say("|recv|", "", Amount);
+			pico_global_conf.LastActivity = PicoNow();
+			if (Amount < Want) break;		// drained it. Saves a syscall that would just say EAGAIN.
+		}
+		if (S >= 0 and !B->AskUnused()) {
+			ReadStalled = true;	// epoll won't tell us again, so the reader must.
+			B->Fills++;
+		}
+	}
+	
+	void unstall () {
+		if (ReadStalled) {
+			ReadStalled = false;
+			pico_wake(Worker);
+		}
+	}
+	
+	void place () {
+		if (Worker or !pico_worker_count) return;
+		Worker = pico_least_loaded();
+		pico_workers[Worker-1].Comms++;
+	}
+	
+	void watch (int FD, int Op=1) { // 1 = EPOLL_CTL_ADD, 2 = EPOLL_CTL_DEL
+		place();
+	#if __linux__
+	#if PICO_URING
+		if (pico_uring.FD >= 0 and FD >= 0 and !(Options & PicoSharedMem)) {
+			if (!Ops) Ops = (PicoOp*)calloc(4, sizeof(PicoOp));
+			if (!Ops) return;		// the ring tells us, instead of epoll.
+			if (Op == 1) ring_start(FD);
+			return;
+		}
+	#endif
+		int Epoll = Worker ? pico_workers[Worker-1].Epoll : -1;
+		if (Epoll < 0 or FD < 0) return;
+		epoll_event E = {};
+		E.events = EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLET;
+		E.data.ptr = this;
+		epoll_ctl(Epoll, Op, FD, &E);
+	#endif
+	}
+	
+	void watch_fds (int Op=1) {
+		watch(Socket, Op);
+		if (StdOut) watch(StdOut->Pipe, Op);
+		if (StdErr) watch(StdErr->Pipe, Op);
+	}
+	
+	void watch_all () {
+		if (Ops) memset((void*)Ops, 0, 4*sizeof(PicoOp)); // forked. Those ops were the parent's.
+		Worker = 0;
+		place();
+		watch_fds();
+	}
+	
+	bool move_to (int W) { // Hand ourselves to another worker. Its epoll reports anything already ready.
+		if (W == Worker or !InUse.enter()) return false;
+		watch_fds(2);
+		pico_workers[Worker-1].Comms--;
+		pico_workers[W-1].Comms++;
+		Worker = W;
+		watch_fds();
+		InUse.leave();
+		pico_wake(W);
+		return true;
+	}
+	
+	bool owned_by (int W) { // unplaced comms go to the first worker.
+		return Worker == W or (!Worker and W == 1);
+	}
+	
+	inline void do_io() {
+		if ((PartClosed&14) != 14 and ReadLock.enter())
+			do_reading();
+		if (can_send() and SendLock.enter())
+			do_sending();
+	}
+
+	void do_reading () {
+		if (!(PartClosed&2)) {
+			if (Options & PicoSharedMem)
+				read_wakeups();
+			  else if (Socket > 0)			// else, its memory-only IPC.
+				ring_read(Reading, Socket, 2, false);
+			if (!ZeroCopy)
+				pre_grab();
+			  else if (must_copy() and pre_grab(false))
+				;							// views can't span pieces, or see compressed data, so we copy those for the user.
+			  else if (Waiting and has_msg())
+				got_msg();
+			if (Socket > 0 and ring_ok() and !(Options & PicoSharedMem))
+				ring_read(Reading, Socket, 2);	// now the grab made room. Else the next message often needs two recvs.
+			if ((Options & PicoSharedMem) and (PartClosed&1) and !Reading->Length())
+				failed(EPIPE, 2);				// the other side is gone, and we've read all it left us.
+		}
+		if (!(PartClosed&4))
+			ring_read(StdOut, StdOut->Pipe, 4);
+		if (!(PartClosed&8))
+			ring_read(StdErr, StdErr->Pipe, 8);
+		ReadLock.leave();
+	}
+	
+	bool ring_ok () {
+	#if PICO_URING and __linux__
+		return Ops and pico_uring.FD >= 0;
+	#else
+		return false;
+	#endif
+	}
+	
+	void ring_read (PicoBuff* B, int S, int Part, bool Post=true) {
+		// With io_uring, `Post=false` only collects a finished receive. The caller posts the next one later.
+		if (!ring_ok())
+			return read_part(B, S, Part);
+	#if PICO_URING and __linux__
+		auto& O = Ops[pico_log2(Part)];
+		if (O.State == 2)
+			ring_done(O, B, Part);
+		if ((PartClosed&Part) or O.State or !Post)
+			return;
+		int n = B->Parts(O.V, false);
+		if (!n) {
+			ReadStalled = true;
+			B->Fills++;
+			return;
+		}
+		io_uring_sqe E = {};
+		E.fd = S;
+		if (Part > 2) {
+			E.opcode = IORING_OP_READV;
+			E.addr = (uint64_t)(uintptr_t)O.V;
+			E.len = n;
+			E.off = (uint64_t)-1;			// pipes have no offset.
+		} else {
+			O.Hdr = {};
+			O.Hdr.msg_iov = O.V; O.Hdr.msg_iovlen = n;
+			E.opcode = IORING_OP_RECVMSG;
+			E.addr = (uint64_t)(uintptr_t)&O.Hdr;
+			E.len = 1;
+			E.msg_flags = MSG_NOSIGNAL;
+		}
+		ring_post(O, E, POLLIN, B, S, Part);
+	#else
+		(void)Post;
+	#endif
+	}
+	
+	void ring_start (int FD) { // post the first receive. Nothing else would, till some other wake-up.
+	#if PICO_URING and __linux__
+		int Part = FD == Socket ? 2 : (StdOut and FD == StdOut->Pipe) ? 4 : (StdErr and FD == StdErr->Pipe) ? 8 : 0;
+		if (!Part or Ops[pico_log2(Part)].State or !ReadLock.enter())
+			return;							// already posted, or a worker is reading and will post it.
+		auto B = Part == 2 ? Reading : Part == 4 ? StdOut : StdErr;
+		ring_read(B, FD, Part);
+		ReadLock.leave();
+	#else
+		(void)FD;
+	#endif
+	}
+	
+	void ring_send () {
+	#if PICO_URING and __linux__
+		auto& O = Ops[0];
+		if (O.State == 2)
+			ring_done(O, Sending, 1);
+		if ((PartClosed&1) or O.State)
+			return;
+		int n = Sending->Parts(O.V, true);
+		if (!n) return;
+		O.Hdr = {};
+		O.Hdr.msg_iov = O.V; O.Hdr.msg_iovlen = n;
+		io_uring_sqe E = {};
+		E.opcode = IORING_OP_SENDMSG;
+		E.fd = Socket;
+		E.addr = (uint64_t)(uintptr_t)&O.Hdr;
+		E.len = 1;
+		E.msg_flags = MSG_NOSIGNAL;
+		ring_post(O, E, POLLOUT, Sending, Socket, 1);
+	#endif
+	}
+
+#if PICO_URING and __linux__
+	void ring_post (PicoOp& O, const io_uring_sqe& E, int Events, PicoBuff* B, int S, int Part) {
+		// Our fds are O_NONBLOCK, so the op alone would just say EAGAIN. A linked poll makes it wait.
+		io_uring_sqe Pair[2] = {{}, E};
+		uint64_t ID = (uint64_t)(uintptr_t)this | pico_log2(Part);
+		Pair[0].opcode = IORING_OP_POLL_ADD;
+		Pair[0].fd = S;
+		Pair[0].poll32_events = Events;
+		Pair[0].flags = IOSQE_IO_LINK;
+		Pair[0].user_data = ID | 4;
+		Pair[1].user_data = ID;
+		O.State = 1;
+		if (pico_uring.Submit(Pair, 2)) return;
+		O.State = 0;						// ring is full. Do it by hand this time.
+		if (Part == 1)
+			plain_send();
+		  else
+			read_part(B, S, Part);
+	}
+	
+	void ring_done (PicoOp& O, PicoBuff* B, int Part) {
+		int R = O.Result;
+		O.State = 0;
+		if (Part <= 2 and R != -ECANCELED)
+			PicoCounters::Add(Part == 1 ? Counts.SendCalls : Counts.ReadCalls);
+		if (R > 0) {
+			Traffic += R;
+			if (Part == 1) {
+				B->lost(R);
+				LastSend = PicoNow();
+				if (CanSayDebug()) Say("|send|", "", R);
+				return;
+			}
+			pico_timeout_count = 0;
+			B->gained(R);
+			B->Note();
+			if (B == Reading) PicoCounters::Peak(Counts.ReadingPeak, B->Length());
+			if (CanSayDebug()) Say("|recv|", "", R);
+			pico_global_conf.LastActivity = PicoNow();
+		} else if (R != -ECANCELED) {
+			errno = -R;
+			io_pass(R ? -1 : 0, Part);
+		}
+	}
+#endif
+	
+	bool ring_idle () { // Can't free buffers or close sockets while the kernel is still using them.
+	#if PICO_URING and __linux__
+		if (!Ops) return true;
+		bool Idle = true;
+		for (int i = 0; i < 4; i++) {
+			auto& O = Ops[i];
+			if (O.State != 1) continue;
+			Idle = false;
+			if (O.Cancelling) continue;
+			O.Cancelling = true;
+			io_uring_sqe E[2] = {};
+			for (int j = 0; j < 2; j++) {	// the poll, or the op waiting on it.
+				E[j].opcode = IORING_OP_ASYNC_CANCEL;
+				E[j].fd = -1;
+				E[j].addr = (uint64_t)(uintptr_t)this | i | (j*4);
+			}
+			if (!pico_uring.Submit(E, 2))
+				O.Cancelling = false;		// try again later
+		}
+		return Idle;
+	#else
+		return true;
+	#endif
+	}
+
+	void read_wakeups () {
+		char Tmp[64];
+		while (true) {
+			int Amount = (int) recv(Socket, Tmp, sizeof(Tmp), MSG_NOSIGNAL|MSG_DONTWAIT);
+			PicoCounters::Add(Counts.ReadCalls);
+			if (Amount < 0 and errno == ECONNRESET)	// unread wake-ups, not lost data.
+				errno = EPIPE;
+			if (Amount <= 0 and !io_pass(Amount, 1)) // other side gone? Then nothing left to send to. What it sent is still in `Reading`.
+				break;
+		}
+	}
+	
+	void send_wakeup () {
+		unsigned int H = Sending->Head;
+		if (H == Notified) return;
+		char Poke = 0;
+		int Amount = (int) send(Socket, &Poke, 1, MSG_NOSIGNAL|MSG_DONTWAIT);
+		PicoCounters::Add(Counts.SendCalls);
+		if (Amount < 0 and errno == EAGAIN) PicoCounters::Add(Counts.Again);
+		if (Amount > 0 or errno == EAGAIN) {		// EAGAIN: plenty of wake-ups are queued already.
+			Notified = H;
+			LastSend = PicoNow();
+		} else {
+			io_pass(Amount, 1);
+		}
+	}
+
+	void do_sending () { 
+		HeldSince = 0;								// before sending, so anything sent after this gets a new deadline.
+		FlushNow = false;
+		if (Options & PicoSharedMem)
+			send_wakeup();
+		  else if (ring_ok())
+			ring_send();
+		  else
+			plain_send();
+		SendLock.leave();
+	}
+	
+	void plain_send () {
+		iovec V[2];
+		while ( int n = Sending->Parts(V, true) ) {
+		// send(MSG_DONTWAIT) does nothing on OSX sadly.
+			msghdr Msg = {};
+			Msg.msg_iov = V; Msg.msg_iovlen = n;
+			int Want = (int)(V[0].iov_len + (n > 1 ? V[1].iov_len : 0));
+			int Amount = (int) sendmsg(Socket, &Msg, MSG_NOSIGNAL|MSG_DONTWAIT);
+			PicoCounters::Add(Counts.SendCalls);
+  			if (Amount > 0) {
+				Sending->lost(Amount);
+				Traffic += Amount;
+				LastSend = PicoNow();
+				if (CanSayDebug()) Say("|send|", "", Amount);
+				if (Amount < Want) break;	// socket is full. We'll hear when it isn't.
+				if (holding()) break;		// more came in as we sent. It waits for its own batch.
+			} else if (!io_pass(Amount, 1))
+				break;
+		}
+	}
+	
+	bool wait_for_space (int n, int Policy) {
+		PicoCounters::Add(Counts.BufferFull);
+		int Need = PicoBuff::Framed(n);
+		if (Need > Sending->Size)
+			return SayEvent("CantSend: Message too large!");
+		if (Policy == PicoSendGiveUp)
+			return (!SendFailCount++) and SayEvent("CantSend: BufferFull");
+		if (wait_unused(Need, SendTimeOut))
+			return true;
+		if (PartClosed&1) return false; // closed!
+		return (!SendFailCount++) and SayEvent("CantSend: TimedOut");
+	}
+	
+	bool send_flagged (const iovec* Parts, int Count, int64_t n, int Policy, int Flags) {
+		if (packs(n))
+			if (int R = send_packed(Parts, Count, n, Policy, Flags); R >= 0) return R;
+		if (Sending->Shrink) adapt_send(-1);
+		bool Fits = Sending->CanFit((int)n) or adapt_send((int)n);
+		if (n > Sending->Size - PicoMsgInfo or n >= PicoStamped)
+			return send_pieces(Parts, Count, n, Policy, Flags);
+		if (!Fits and !wait_for_space((int)n, Policy)) return false;
+		return sent(Sending->SendOutputV(Parts, Count, (int)n, Flags));
+	}
+	
+	bool send_stamped (const iovec* Parts, int Count, int64_t n, int Policy) {
+		// Puts the time in front of the message, flagged with `PicoStamped`. The reader notes how long it took to be got.
+		iovec Small[16];
+		iovec* P = Count < 16 ? Small : (iovec*)malloc(sizeof(iovec) * (Count+1));
+		if (!P) return fail_alloc();
+		int64_t Now = pico_now_ns();
+		P[0] = {&Now, sizeof(Now)};
+		memcpy(P+1, Parts, sizeof(iovec) * Count);
+		bool OK = send_flagged(P, Count+1, n + sizeof(Now), Policy, PicoStamped);
+		if (P != Small) free(P);
+		return OK;
+	}
+	
+	bool packs (int64_t n) {
+		return (Options & PicoCompressMsgs) and n >= std::max(PackAbove, 16) and n < PicoStamped;
+	}
+	
+	int send_packed (const iovec* Parts, int Count, int64_t n, int Policy, int Flags=0) {
+		// Compresses the message, and sends that instead, flagged with `PicoPacked`.
+		// Returns -1 if it didn't shrink enough to be worth it, so the caller sends it as-is.
+		int Bound = pico_lz_bound((int)n);
+		int Gather = Count > 1 ? (int)n : 0;
+		if (Bound + Gather > PackingCap) {
+			free(Packing);
+			PackingCap = 0;
+			if (!(Packing = (char*)malloc(Bound + Gather))) return -1;
+			PackingCap = Bound + Gather;
+		}
+		const char* Src = (const char*)Parts[0].iov_base;
+		if (Gather) {									// join the parts, after the output space.
+			char* G = Packing + Bound;
+			for (int i = 0; i < Count; i++) {
+				memcpy(G, Parts[i].iov_base, Parts[i].iov_len);
+				G += Parts[i].iov_len;
+			}
+			Src = Packing + Bound;
+		}
+		int P = pico_lz_pack(Src, (int)n, Packing, Bound);
+		if (!P or P > n - n/8) return -1;
+		
+		if (Sending->Shrink) adapt_send(-1);
+		if (P > Sending->Size - PicoMsgInfo) {
+			iovec V = {Packing, (size_t)P};
+			return send_pieces(&V, 1, P, Policy, PicoPacked|Flags);
+		}
+		if (!Sending->CanFit(P) and !adapt_send(P) and !wait_for_space(P, Policy)) return false;
+		return sent(Sending->SendOutput(Packing, P, PicoPacked|Flags));
+	}
+	
+	bool send_pieces (const iovec* Parts, int Count, int64_t n, int Policy, int Flags=0) {
+		// Too big for the buffer, so it goes in pieces. All but the last have `PicoMore` set. The reader joins them.
+		// `Flags` go on the last piece.
+		// Once started, we must finish, so later pieces always wait for space.
+		int Piece = std::min(Sending->Size/4, 16*1024) - PicoMsgInfo;	// fits even the smallest reader.
+		int P = 0; size_t Off = 0;
+		for (bool Started = false; n > 0; Started = true) {
+			int C = (int)std::min(n, (int64_t)Piece);
+			n -= C;
+			if (!Sending->CanFit(C) and !wait_for_space(C, Started ? PicoSendCanTimeOut : Policy))
+				return Started and give_up_pieces();
+			int NetLen = letoh(C | (n ? PicoMore : Flags));
+			Sending->send_sub((char*)&NetLen, PicoMsgInfo);
+			for (int Left = C; Left > 0;) {
+				while (Off >= Parts[P].iov_len and P+1 < Count) {P++; Off = 0;}	// zero-length parts get skipped, but never past the end.
+				int Take = (int)std::min((size_t)Left, Parts[P].iov_len - Off);
+				Left -= Take;
+				Sending->send_sub((const char*)Parts[P].iov_base + Off, Take, !Left);
+				Off += Take;
+			}
+			sent(pico_global_conf.LastActivity = PicoNow());
+		}
+		return true;
+	}
+	
+	bool give_up_pieces () { // tell the reader to throw away the pieces it has.
+		int NetLen = letoh(PicoMore);
+		if (!(PartClosed&1) and Sending->CanFit(0)) {
+			Sending->send_sub((char*)&NetLen, PicoMsgInfo);
+			sent(PicoNow());
+		} else {
+			failed(ETIMEDOUT, 1);						// can't even say that. The stream is broken.
+		}
+		return false;
+	}
+	
+	bool adaptive () { // Only for sockets. Threads and shared-memory have someone else using our buffers.
+		return (Options & (PicoAdaptiveBuffs|PicoSharedMem)) == PicoAdaptiveBuffs and Socket > 0 and Sending and Reading;
 	}
 	
-	bool queue_sub (const char* msg, int n) {
-		if (!Sending) return false;
-		auto D = Sending->SendOutput(msg, n);
-		if (!D) return false;
-		if (Socket < 0) LastSend = D; // threaded
+	bool op_idle (int i) {
+	#if PICO_URING and __linux__
+		return !Ops or !Ops[i].State;
+	#else
+		(void)i;
 		return true;
+	#endif
 	}
 	
-	void read_part (PicoBuff* B, int S, int Part) {
-		if (S >= 0) while ( auto Msg = B->AskUnused() ) {
-			int Amount = 0;
-			if (Part > 2)
-				Amount = (int) read(S, Msg.Data, Msg.Length);
-			  else // maybe nicer to avoid sockets and just use pipes. Simpler and more flexible.
-			       // and can still use sockets.
-				Amount = (int) recv(S, Msg.Data, Msg.Length, MSG_NOSIGNAL|MSG_DONTWAIT);
-			if (Amount <= 0) {
-				if (!io_pass(Amount, Part)) break;
-				continue;
-			}
-//			B->Log(Msg.Data, Amount);
-			pico_timeout_count = 0;			// reset
-			B->gained(Amount);
-			if (CanSayDebug()) Say("|recv|", "", Amount);
-			pico_global_conf.LastActivity = PicoNow();
+	bool resize (int Slot, int Bits) {
+		// Caller must hold whatever stops the other side touching this buffer. Slot 0 = Sending, 1 = Reading.
+		PicoBuff*& B = Slot ? Reading : Sending;
+		auto Old = B;
+		if (Old->Length() > (1<<Bits) - 4) return false;
+		auto New = PicoBuff::New(Bits, Old->Name, this, Old->Pipe, Old->MapSize, buff_node());
+		if (!New) return false;
+		if (New->Size != 1<<Bits) {						// calloc gave us less.
+			PicoBuff::Decr(New);
+			return false;
 		}
+		New->CopyFrom(Old);
+		B = New;
+		Old->Older = Retired[Slot];
+		Retired[Slot] = Old;
+		RetiredAge[Slot] = 0;
+		if (CanSayDebug()) Say("Resized", Old->Name, New->Size);
+		return true;
 	}
 	
-	inline void do_io() {
-		if ((PartClosed&14) != 14 and ReadLock.enter())
-			do_reading();
-		if (can_send() and SendLock.enter())
-			do_sending();
+	bool adapt_send (int n) {
+		// Called by the sender, who is the only one adding to `Sending`. `n < 0` means shrink.
+		auto S = Sending;
+		if (!adaptive() or Reserved) return false;
+		int Bits = pico_log2(S->Size);
+		int MaxBits = std::clamp(pico_log2(std::max(MaxBuffSize, 1)), 14, 30);
+		int MinBits = std::clamp(pico_log2(std::max(MinBuffSize, 1)), 14, MaxBits);
+		if (n < 0) {
+			S->Shrink = false;
+			if (Bits <= MinBits or S->Length() > S->Size/8) return false;
+			Bits--;
+		} else {
+			int64_t Need = (int64_t)PicoBuff::Framed(n) + S->Length();
+			if (++S->Fills < 2 and Need <= S->Size) return false;	// once could be a fluke.
+			Bits = std::min(Bits+2, MaxBits);
+			while (Bits < MaxBits and (1LL<<Bits) < Need)
+				Bits++;
+			if ((1<<Bits) <= S->Size) return false;
+		}
+		SendLock.lock();
+		bool OK = op_idle(0) and resize(0, Bits);
+		SendLock.leave();
+		return OK and S->Size < Sending->Size;
 	}
-
-	void do_reading () {
-		if (!(PartClosed&2)) {
-			if (Socket > 0)					// else, its memory-only IPC.
-				read_part(Reading, Socket, 2);
-			if (!PreData) pre_grab();
+	
+	void adapt () {
+		// The owning worker calls this 4x a second. Grows `Reading` if it keeps filling, shrinks it if it is mostly empty.
+		for (int i = 0; i < 2; i++) {
+			auto& Lock = i ? ReadLock : SendLock;		// the sender retires into slot 0 itself, under `SendLock`.
+			if (!Retired[i] or !Lock.enter()) continue;
+			if (++RetiredAge[i] > 1) {
+				PicoBuff::Decr(Retired[i]);
+				Retired[i] = nullptr;
+			}
+			Lock.leave();
+		}
+		if (!adaptive()) return;
+		
+		if (Sending->Idle())
+			Sending->Shrink = true;
+		Sending->Fills = 0;
+		
+		auto R = Reading;
+		int Bits = pico_log2(R->Size);
+		int MaxBits = std::clamp(pico_log2(std::max(MaxBuffSize, 1)), 14, 30);
+		int MinBits = std::clamp(pico_log2(std::max(MinBuffSize, 1)), 14, MaxBits);
+		int Want = Bits;
+		bool Idle = R->Idle();
+		auto Q = Unread.load();
+		bool Backlog = Q and Q->Full(UnreadLimit);		// then the user is the hold-up, not us.
+		if (R->Fills >= 2 and !Backlog)
+			Want = std::min(Bits+2, MaxBits);
+		  else if (Idle and R->Length() <= R->Size/8)
+			Want = std::max(Bits-1, MinBits);
+		R->Fills = 0;
+		if (Want == Bits or !ReadLock.enter()) return;
+		if (GrabLock.enter()) {							// a `PicoGetView()` holds this, while it lends out our memory.
+			if (op_idle(1) and resize(1, Want))
+				unstall();
+			GrabLock.leave();
 		}
-		if (!(PartClosed&4))
-			read_part(StdOut, StdOut->Pipe, 4);
-		if (!(PartClosed&8))
-			read_part(StdErr, StdErr->Pipe, 8);
 		ReadLock.leave();
 	}
-
-	void do_sending () { 
-		while ( auto Msg = Sending->AskUsed() ) {
-		// send(MSG_DONTWAIT) does nothing on OSX sadly.
-			int Amount = (int) send(Socket, Msg.Data, Msg.Length, MSG_NOSIGNAL|MSG_DONTWAIT);
-  			if (Amount > 0) {
-				Sending->lost(Amount);
-				LastSend = PicoNow();
-				if (CanSayDebug()) Say("|send|", "", Amount);
-			} else if (!io_pass(Amount, 1))
+	
+	bool wait_unused (int Bytes, float T) {
+		// Sleeps until the reader (or the worker's sends) free up `Bytes` of space.
+		auto B = Sending;
+		if (T < 0) T = SendTimeOut;
+		PicoDate Final = PicoNow() + (PicoDate)(std::min(T, 543210000.0f)*65536.0f);
+		bool Rz = false;
+		int64_t Start = pico_now_ns();
+		B->Waiters++;
+		while (!(PartClosed&1)) {
+			unsigned int Seen = B->Tail;
+			if ((Rz = B->Unused() >= Bytes))
 				break;
+			float Left = (Final - PicoNow()) * (1.0f/65536.0f);
+			if (Left <= 0) break;
+			pico_futex_wait(&B->Tail, Seen, Left);
 		}
-		SendLock.leave();
+		B->Waiters--;
+		PicoCounters::Add(Counts.BlockedNS, pico_now_ns() - Start);
+		return Rz;
+	}
+	
+	bool SendWait (int Bytes, float T) {
+		if (!Sending or PartClosed&1 or Bytes > Sending->Size) return false;
+		return Sending->Unused() >= Bytes or (T and wait_unused(Bytes, T));
+	}
+	
+	void wake_senders () {
+		if (Sending and Sending->Waiters)
+			pico_futex_wake(&Sending->Tail);
 	}
 	
 	bool can_send () {
-		return !(PartClosed&1)  and  (Socket > 0)  and  (Sending->Length());
+		return !(PartClosed&1)  and  (Socket > 0)  and  (Sending->Length())  and  !holding();
 	}
 
-	bool delay_read (float T) {
+	bool delay_read (float T, bool View=false) {
 		if (T < 0) T = SendTimeOut;
 		T = std::min(T, 543210000.0f); // 17 years?
 		PicoDate Final = PicoNow() + (PicoDate)(T*65536.0f);
-		timespec ts = {0, 1000000}; int n = T*16000;
-		for ( int i = 0;  i < n and !(PartClosed&2);   i++) {
-			nanosleep(&ts, 0);
-			if (PreData) return true; 
-			if (PicoNow() > Final) return false;
+		bool Rz = false;
+		Waiting++;
+		while (!(PartClosed&2)) {
+			unsigned int Seen = Arrivals;	// read before checking, so we can't miss a wake-up.
+			if ((Rz = View ? has_msg() : (queued() or pre_grab())))
+				break;
+			float Left = (Final - PicoNow()) * (1.0f/65536.0f);
+			if (Left <= 0) break;
+			pico_futex_wait(&Arrivals, Seen, Left);
 		}
-		return false;
+		Waiting--;
+		return Rz;
+	}
+	
+	void got_msg () { // wakes any blocking `Get()`
+		Arrivals++;
+		if (Waiting)
+			pico_futex_wake(&Arrivals);
+	}
+	
+	bool has_msg () {									// a whole message is waiting?
+		if (queued()) return true;
+		if (must_copy()) return false;
+		auto B = Reading;								// no lock, so a resize can swap it. Look at one buffer only.
+		int N = B->Length();
+		int L = PreLength;
+		if (!L) {
+			if (N < PicoMsgInfo) return false;
+			L = htole(B->PeekLength());
+			N -= PicoMsgInfo;
+		}
+		return N >= L;
+	}
+	
+	PicoMessage view_sub () {
+		if (queued())									// the worker got to it first.
+			return view_queued();
+		
+		GrabLock.lock();
+		if (queued()) {									// it joined pieces in, while we waited. Those come first.
+			GrabLock.leave();
+			return view_queued();
+		}
+		if (must_copy())
+			return view_copy();
+		auto B = Reading;
+		int Skip = 0;
+		int L = peek_msg(Skip);
+		if (L <= 0)
+			return view_fail(-L);
+		
+		int T = (B->Tail + Skip) & (B->Size - 1);
+		if (T + L <= B->Size) {							// contiguous, so lend it out.
+			ViewLength = Skip + L + (-L&3);
+			LastRead = PicoNow();
+			got_bytes(L);
+			return {B->Data + T, L};
+		}
+		
+		if (Skip) {PreLength = L; B->lost(Skip);}		// wraps around, so copy it.
+		return view_copy();
+	}
+	
+	PicoMessage view_queued () {
+		ViewLength = -1;
+		note_latency(Unread.load());
+		return Unread.load()->Front();
+	}
+	
+	PicoMessage view_copy () {
+		bool OK = pre_grab_sub();
+		GrabLock.leave();
+		if (!OK) return {};
+		return view_queued();
+	}
+	
+	int peek_msg (int& Skip) {
+		// Needs GrabLock. The length of the next whole message in `Reading`. 0 if there isn't one, or -errno.
+		auto B = Reading;
+		int L = PreLength;
+		Skip = 0;
+		if (L < 0) return 0;							// bad stream, already reported.
+		if (!L) {
+			if (B->Length() < PicoMsgInfo) return 0;
+			L = htole(B->PeekLength());
+			if (L <= 0) {
+				if (L == 0) B->lost(PicoMsgInfo);
+				return L < 0 ? -EILSEQ : 0;
+			}
+			if (B->Size < L + PicoMsgInfo)
+				return -EMSGSIZE;
+			Skip = PicoMsgInfo;
+		}
+		return (B->Length() < Skip + L) ? 0 : L;
+	}
+	
+	PicoMessage append_sub (PicoAppenderFn Fn, void* Obj, int* Need) {
+		// Like `view_sub()`, but copies the message into memory `Fn` gives us. If `Fn` says no, the message stays.
+		if (queued()) {									// the worker got to it first.
+			auto Q = Unread.load();
+			int L = Q->Front().Length;
+			char* Dest = (Fn)(Obj, L);
+			if (!Dest) return *Need = L, PicoMessage{};
+			auto M = pop();
+			memcpy(Dest, M.Data, L);
+			msg_free(M.Data);
+			return {Dest, L};
+		}
+		
+		GrabLock.lock();
+		if (queued()) {									// it joined pieces in, while we waited. Those come first.
+			GrabLock.leave();
+			return append_sub(Fn, Obj, Need);
+		}
+		if (must_copy()) {								// pieces need joining first.
+			pre_grab_sub(false);
+			GrabLock.leave();
+			return queued() ? append_sub(Fn, Obj, Need) : PicoMessage{};
+		}
+		int Skip = 0;
+		int L = peek_msg(Skip);
+		if (L <= 0) {
+			view_fail(-L);
+			return {};
+		}
+		char* Dest = (Fn)(Obj, L);
+		if (!Dest) {
+			GrabLock.leave();
+			return *Need = L, PicoMessage{};
+		}
+		if (Skip) Reading->lost(Skip);
+		Reading->ReadInput4(Dest, L);
+		PreLength = 0;
+		got_bytes(L);
+		LastRead = PicoNow();
+		Traffic += L;
+		GrabLock.leave();
+		unstall();
+		return {Dest, L};
+	}
+	
+	PicoMessage view_fail (int Err = 0) {
+		GrabLock.leave();
+		if (Err) failed(Err);
+		return {};
 	}
 	
 	static char* phalloc (int n) {
@@ -881,39 +2849,214 @@ struct PicoComms : PicoConfig {
 		return Result;
 	}
 	
-	bool pre_grab () {
+	bool queued () {
+		auto Q = Unread.load();
+		return Q and Q->Any();
+	}
+	
+	PicoMessage pop (bool Note=true) {
+		auto Q = Unread.load();
+		if (!Q) return {};
+		if (Note and Q->Any()) note_latency(Q);
+		PicoMessage M = Q->Pop();
+		unstall();										// the worker might have stopped, due to a full queue.
+		return M;
+	}
+	
+	bool pre_grab (bool All=true) {
 		if (!GrabLock.enter())
-			return false;
-		bool Result = pre_grab_sub();
+			return queued();
+		bool Result = pre_grab_sub(All);
 		GrabLock.leave();
 		return Result;
 	}
-		
-	bool pre_grab_sub () {
+	
+	bool must_copy () {								// is the next message in pieces, or compressed? Only `pre_grab_sub()` reads those.
+		if (Partial) return true;
 		int L = PreLength;
-		if (!L) {
-			PreLength = L = htole(Reading->ReadLength()); 
-			if (L <= 0)
-				return L < 0 and failed(EILSEQ);
-			if (Reading->Size < L + PicoMsgInfo)			// msg bigger than our buffers
-				return failed(EMSGSIZE);
+		if (!L and Reading->Length() >= PicoMsgInfo)
+			L = htole(Reading->PeekLength());
+		return L > 0 and (L & PicoFlags);
+	}
+	
+	char* unpack (const char* In, int N, int& L) {
+		// Decompresses a `PicoPacked` message into a new message. Fails the stream if it is corrupt.
+		L = pico_lz_size(In, N);
+		char* Data = L > 0 ? msg_alloc(L) : nullptr;
+		if (Data and pico_lz_unpack(In, N, Data, L) == L) {
+			Data[L] = 0;
+			return Data;
+		}
+		if (Data or L <= 0)
+			failed(EILSEQ, 2);
+		  else
+			fail_alloc();
+		msg_free(Data);
+		return nullptr;
+	}
+	
+	bool join_piece (int L) {
+		int Skip = pool_skip();
+		int Need = Skip + PartialLength + L + 1;
+		if (Need < 0) return false;					// over 2GB
+		if (Need > PartialCap) {
+			int Cap = (int)std::min(std::max((int64_t)PartialCap*2, (int64_t)Need), (int64_t)INT32_MAX);
+			char* P = (char*)realloc(Partial, Cap);
+			if (!P) return false;
+			Partial = P;
+			PartialCap = Cap;
+		}
+		Reading->ReadInput4(Partial + Skip + PartialLength, L);
+		PartialLength += L;
+		return true;
+	}
+	
+	int pool_skip () {								// pooled messages have a header before them.
+		return (Options & PicoPooledMsgs) ? sizeof(PicoBlock) : 0;
+	}
+	
+	char* msg_alloc (int n) {
+		if (!(Options & PicoPooledMsgs))
+			return phalloc(n);
+		if (!Pool and !(Pool = PicoMsgPool::New()))
+			return nullptr;
+		return Pool->Alloc(n);
+	}
+	
+	void msg_free (char* Data) {
+		if (Options & PicoPooledMsgs)
+			PicoMsgPool::Free(Data);
+		  else
+			free(Data);
+	}
+	
+	bool unstamp (char* Data, int& L, int64_t& When) { // takes the send-time off the front of a joined message.
+		if (L < (int)sizeof(When)) {
+			msg_free(Data);
+			return failed(EILSEQ, 2);
 		}
+		memcpy(&When, Data, sizeof(When));
+		L -= sizeof(When);
+		memmove(Data, Data + sizeof(When), L + 1);		// and the zero.
+		return true;
+	}
+	
+	void note_latency (PicoQueue* Q) {					// the user just got the front message.
+		int64_t When = Q->FrontSent();
+		if (!When) return;
+		if (!Latency and !(Latency = (PicoLatency*)calloc(1, sizeof(PicoLatency)))) return;
+		Latency->Note(pico_now_ns() - When);
+	}
+	
+	void drop_pieces () {
+		free(Partial);
+		Partial = nullptr;
+		PartialLength = 0;
+		PartialCap = 0;
+	}
 		
-		if (Reading->Length() < L)
-			return false;
+	bool pre_grab_sub (bool All=true) {
+		// Moves all the whole messages out of `Reading`, into the unread queue. Until the queue is full.
+		// Messages sent in pieces are joined back together here. `All=false` only does those.
+		auto Q = Unread.load();
+		if (!Q and !(Q = (PicoQueue*)calloc(1, sizeof(PicoQueue))))
+			return fail_alloc();
+		Unread = Q;
+		
+		int Got = 0;
+		bool Took = false;									// freed space in `Reading`, even if only a piece.
+		while (!Q->Full(UnreadLimit)) {
+			if (!All and !must_copy()) break;
+			int L = PreLength;
+			if (L < 0) break;								// bad stream, already reported.
+			if (!L) {
+				if (Reading->Length() < PicoMsgInfo) break;
+				PreLength = L = htole(Reading->ReadLength()); 
+				Took = true;
+				if (!L) continue;
+				if (L < 0) {
+					failed(EILSEQ, 2);
+					break;
+				}
+				if (Reading->Size < (L&~PicoFlags) + PicoMsgInfo) {	// msg bigger than our buffers
+					PreLength = -1;
+					failed(EMSGSIZE, 2);
+					break;
+				}
+			}
+			
+			int More = L & PicoMore;
+			int Packed = L & PicoPacked;
+			int Stamped = L & PicoStamped;
+			L &= ~PicoFlags;
+			if (More and !L) {								// the sender gave up half-way.
+				PreLength = 0;
+				drop_pieces();
+				continue;
+			}
+			if (Reading->Length() < L)
+				break;
+			
+			int64_t When = 0;
+			char* Data;
+			if (More or Partial or Packed) {				// compressed ones get joined too, then unpacked.
+				if (!join_piece(L)) {
+					fail_alloc();
+					break;
+				}
+				PreLength = 0;
+				if (More) continue;
+				Data = Partial + pool_skip(); L = PartialLength;
+				if (Packed) {
+					Data = unpack(Data, L, L);
+					drop_pieces();
+					if (!Data) break;
+				} else {
+					Data[L] = 0;
+					if (Data != Partial)
+						PicoMsgPool::Unpooled(Pool, Partial);
+					Partial = nullptr;
+					PartialLength = 0;
+					PartialCap = 0;
+				}
+				if (Stamped and !unstamp(Data, L, When))
+					break;
+			} else {
+				int Skip = Stamped ? sizeof(When) : 0;
+				if (L < Skip) {
+					PreLength = -1;
+					failed(EILSEQ, 2);
+					break;
+				}
+				Data = msg_alloc(L - Skip);
+				if (!Data) {
+					fail_alloc();
+					break;
+				}
+				Reading->ReadInput((char*)&When, Skip);
+				L -= Skip;
+				Reading->ReadInput4(Data, L);
+				PreLength = 0;
+			}
+			Q->Push({Data, L}, When);
+			got_bytes(L);
+			Traffic += L;
+			Got++;
+		}
 		
-		if (char* Data = phalloc(L+1); Data) {
-			Reading->ReadInput4(Data, L);
-			PreData = Data;
+		if (Got) {
 			LastRead = PicoNow();
-			return true;
+			got_msg();
 		}
-
-		return fail_alloc();
+		if (Took)
+			unstall();									// a joined piece makes room too.
+		if (Q->Full(UnreadLimit) and Reading->Length() > 0)
+			ReadStalled = true;							// wake us, once the user makes room.
+		return Q->Any();
 	}
 	
 	bool get_pair_of (int* Socks) {
-		if (pico_open_sockets > 96 or socketpair(PF_LOCAL, SOCK_STREAM, 0, Socks)) return failed();
+		if (socketpair(PF_LOCAL, SOCK_STREAM, 0, Socks)) return failed();
 		struct linger so_linger = {1, 5};
 		for (int i = 0; i < 2; i++)
 			setsockopt(Socks[i], SOL_SOCKET, SO_LINGER, &so_linger, sizeof so_linger);
@@ -921,13 +3064,27 @@ struct PicoComms : PicoConfig {
 	}
 	
 	bool alloc_msg_buffs () {
-		if (!Sending and !(Sending = PicoBuff::New(Bits, "Send", this, -1)))
+		bool OK = PicoInit(0);		// first, so we know which worker we get, and where it runs.
+		place();
+		bool Mirror = Options & PicoMirrorBuffs;
+		int Node = (Sending and Reading) ? -1 : buff_node();
+		if (!Sending and !(Sending = PicoBuff::New(Bits, "Send", this, -1, Mirror, Node)))
 			return failed(ENOBUFS);
-		if (!Reading and !(Reading = PicoBuff::New(Bits, "Read", this, -1)))
+		if (!Reading and !(Reading = PicoBuff::New(Bits, "Read", this, -1, Mirror, Node)))
 			return failed(ENOBUFS);
 		PartClosed &= ~3; // Open up sending and reading. Say they are "not closed".
 		PartClosed &= 15; // Make it not 255 anymore.
-		return PicoInit(0);
+		return OK;
+	}
+	
+	int buff_node () { // Our pinned worker's NUMA node. Otherwise the node of whoever is creating us.
+		if (pico_numa_nodes() < 2) return -1;
+		if (Worker) {
+			auto& K = pico_workers[Worker-1];
+			if (K.Pinned and K.Node >= 0)
+				return K.Node;
+		}
+		return pico_node_here();
 	}
 
 	void unblock (int Pipe) {
@@ -947,10 +3104,11 @@ struct PicoComms : PicoConfig {
 		unblock(Sock);
 		Socket = Sock;
 		pico_open_sockets++;
-		return alloc_msg_buffs() and mark_started();
+		return alloc_msg_buffs() and (watch(Sock), mark_started());
 	}
 
 	bool mark_started () {
+		place();
 		SocketStatus = 0;
 		PIDStatus = -1;
 		if (CanSayDebug()) Say("Started");
@@ -970,6 +3128,10 @@ struct PicoComms : PicoConfig {
 		
 		C |= P;
 		PartClosed = C;
+		if (P&2)
+			got_msg();
+		if (P&1)
+			wake_senders();
 		if (C == 15)				// fully closed! perhaps the process died. Lets find out fast.
 			check_exit_code();
 		
@@ -997,7 +3159,10 @@ struct PicoComms : PicoConfig {
 
 		int e = errno;
 						;;;/*_*/;;;
-		if (e == EAGAIN) return false;
+		if (e == EAGAIN) {
+			PicoCounters::Add(Counts.Again);
+			return false;
+		}
 		if (e == EINTR)  return true;
 		return failed(e, Part);
 	}
@@ -1025,6 +3190,7 @@ struct PicoComms : PicoConfig {
 	
 	bool all_closed() {
 		int S = Socket; if (S < 0) return false;
+		if (!ring_idle()) return false;
 		if (!ReadLock.enter()) return false;
 		msg_close_for_real(S);
 		ReadLock.leave();
@@ -1077,48 +3243,99 @@ struct PicoComms : PicoConfig {
 	void cleanup (PicoDate CheckPID) {
 		if (!InUse.enter())
 			return;
+		bool Again = KeepAlive;
 		
-		if (KeepAlive == 0) {
+		if (KeepAlive == 0 and !ring_idle())
+			;								// wait for the cancels to come back.
+		  else if (KeepAlive == 0) {
 			if (CanSayDebug()) Say("Bye");
 			check_exit_code(); // cleanup process PID list...
 			kill_me();
-			Destroy();
+			if (Destroy())
+				return;						// the slot may be someone else's already.
 		} else if (ExecFlags&PicoExecWantDead)
 			kill_me();
 		  else if (CheckPID or (PartClosed&15)==15)
 			check_exit_code();
+		if (CheckPID and KeepAlive)
+			adapt();
 
 		InUse.leave();
+		if (Again and Retry)		// an epoll event came in while we were busy
+			io();
 	}
 	
 	;;;/*_*/;;;
 	void io () {
-		if (!KeepAlive or !InUse.enter())
-			return;
-		// lock might be a little too aggressive.
-		// it dissallows two threads to both read/write at the same time
-		// but we still do want to block destruction/kill/waitpid
-		int P = PartClosed;			
-		if ((P&15) != 15)
-			do_io();
-		  else if (P != 255)
-			all_closed();
-		InUse.leave();
+		Retry = true; // whoever is holding `InUse` will come back around.
+		while (KeepAlive and Retry and InUse.enter()) {
+			Retry = false;
+			// lock might be a little too aggressive.
+			// it dissallows two threads to both read/write at the same time
+			// but we still do want to block destruction/kill/waitpid
+			int P = PartClosed;			
+			if ((P&15) != 15)
+				do_io();
+			  else if (P != 255)
+				all_closed();
+			InUse.leave();
+		}
 	}
 };
 
 
-static void pico_cleanup () {
-	static PicoDate LastCheck = 0;
+static PicoDate pico_cleanup (int W) {
+	auto& K = pico_workers[W-1];
 	PicoDate Now = PicoNow();
-	if (abs(Now - LastCheck) > 64*1024*0.25) // 4x a second
-		LastCheck = Now;
-	  else
+	if (abs(Now - K.LastCheck) > 64*1024*0.25) { // 4x a second
+		K.LastCheck = Now;
+		K.Node = pico_node_here();
+	} else {
 		Now = 0;
+	}
 	
 	PicoLister Items;
 	while (auto M = Items.NextComm())
-		M->cleanup(Now);
+		if (M->owned_by(W))
+			M->cleanup(Now);
+	return Now;
+}
+
+
+static void pico_rebalance () {
+	// Moves one comm from the busiest worker to the idlest. Only one that makes them more even.
+	int N = pico_worker_count;
+	if (N < 2) return;
+	int64_t Load[6] = {};
+	PicoLister Items;
+	while (auto M = Items.NextComm())
+		if (M->Worker)
+			Load[M->Worker-1] += M->Traffic;
+	
+	int Hi = 0;
+	for (int i = 1; i < N; i++)
+		if (Load[i] > Load[Hi]) Hi = i;
+	int Lo = Hi;
+	auto& H = pico_workers[Hi];
+	for (int i = 0; i < N; i++) {					// pinned workers keep their comms on the same node.
+		auto& K = pico_workers[i];
+		bool Far = H.Pinned and K.Pinned and H.Node != K.Node;
+		if (!Far and Load[i] < Load[Lo]) Lo = i;
+	}
+	int64_t Gap = Load[Hi] - Load[Lo];
+	bool Uneven = Gap > 64*1024 and Load[Hi] > 2*Load[Lo];
+	
+	PicoComms* Best = nullptr; int64_t BestLoad = 0;
+	PicoLister Again;
+	while (auto M = Again.NextComm()) {
+		int64_t T = M->Traffic.exchange(0);
+		if (Uneven and M->Worker == Hi+1 and M->Socket >= 0 and T > BestLoad and T < Gap) {	// thread pairs stay together.
+			Best = M;
+			BestLoad = T;
+		}
+	}
+	if (Best)
+		Best->move_to(Lo+1);
 }
 
 
@@ -1128,12 +3345,12 @@ static bool pico_try_exit () {
 		return true;
 
 	if (pico_global_conf.TimeOut <= 0)
-		return pico_timeout_count = 0;
+		return (pico_timeout_count = 0);
 	;;;/*_*/;;;
 
 	PicoDate MaxTime = pico_global_conf.TimeOut + pico_global_conf.LastActivity;
 	if (MaxTime >= D)
-		return pico_timeout_count = 0;
+		return (pico_timeout_count = 0);
 
 	// Fail a few times, first. In case of computer-suspend.
 	if (++pico_timeout_count > 12)
@@ -1145,19 +3362,158 @@ static bool pico_try_exit () {
 }
 
 
-static void pico_work_comms () {
+static void pico_work_all (int W) {
 	PicoLister Items;
 	while (auto M = Items.NextComm())
-		M->io();
-	
+		if (M->owned_by(W))
+			M->io();
+}
+
+
+static float pico_idle_time (float Min) {
 	float S = (PicoNow() - pico_global_conf.LastActivity) * (0.000015258789f * 0.005f);
+	return std::clamp(S*S, Min, 0.5f);
+}
+
+
+#if PICO_URING and __linux__
+static void pico_ring_reap (int W) {
+	// Only the owner does a comm's io. Others get woken, and find their op done when they sweep.
+	auto& R = pico_uring;
+	while (R.FD >= 0 and R.ReapLock.enter()) {
+		unsigned H = *R.CQHead;
+		while (H != __atomic_load_n(R.CQTail, __ATOMIC_ACQUIRE)) {
+			io_uring_cqe E = R.CQEs[H & *R.CQMask];
+			__atomic_store_n(R.CQHead, ++H, __ATOMIC_RELEASE);
+			auto M = (PicoComms*)(uintptr_t)(E.user_data & ~(uint64_t)7);
+			if (!M or (E.user_data & 4)) continue;	// a cancel or poll finished. The op says the rest.
+			auto& O = M->Ops[E.user_data & 3];
+			O.Result = E.res;
+			O.Cancelling = false;
+			O.State = 2;
+			if (M->owned_by(W))
+				M->io();
+			  else
+				pico_wake(M->Worker);
+		}
+		bool Over = R.Overflowed();
+		R.ReapLock.leave();
+		if (!Over and H == __atomic_load_n(R.CQTail, __ATOMIC_ACQUIRE))
+			break;							// else more came in as we left.
+	}
+}
+#endif
+
+
+static float pico_wait_time (int W, float Min) { // held-back sends might need us sooner.
+	float S = pico_idle_time(Min);
+	if (PicoDate By = pico_workers[W-1].FlushBy)
+		S = std::clamp((By - PicoNow()) * (1.0f/65536.0f), 0.0f, S);
+	return S;
+}
 
-	S = std::clamp(S*S, 0.001f, 0.5f);
+
+static bool pico_flush_due (int W) {
+	auto& F = pico_workers[W-1].FlushBy;
+	PicoDate By = F;
+	if (!By or PicoNow() < By) return false;
+	F = 0;											// the comms still holding will set it again.
+	return true;
+}
+
+
+#if __linux__
+static int pico_epoll_wait (int E, epoll_event* Events, int Max, float S) {
+	#ifdef SYS_epoll_pwait2							// microseconds matter for `SendDelay`.
+	static bool NoWait2;
+	if (!NoWait2) {
+		timespec ts = {(time_t)S, (long)((S - (int)S)*1000000000.0f)};
+		int N = (int)syscall(SYS_epoll_pwait2, E, Events, Max, &ts, nullptr, 0);
+		if (N >= 0 or errno != ENOSYS) return N;
+		NoWait2 = true;
+	}
+	#endif
+	return epoll_wait(E, Events, Max, (int)ceilf(S*1000.0f));
+}
+#endif
+
+
+static void pico_wait_comms (int W) {
+#if __linux__
+	// Only touch the comms that epoll says are ready. Sweep all of ours on timeouts, or when woken.
+	auto& K = pico_workers[W-1];
+	epoll_event Events[64];
+	int N = pico_epoll_wait(K.Epoll, Events, 64, pico_wait_time(W, 0.01f));
+	bool All = pico_flush_due(W) or N == 0;
+	for (int i = 0; i < N; i++) {
+	#if PICO_URING
+		if (Events[i].data.ptr == &pico_uring) {
+			pico_ring_reap(W);
+			continue;
+		}
+	#endif
+		if (auto M = (PicoComms*)Events[i].data.ptr) {
+			M->io();
+		} else {
+			uint64_t Count;
+			if (read(K.WakeFD, &Count, sizeof(Count))) {;}
+			K.WakePending = false;			// after the read. Else a wake in between is read, but its edge is lost.
+			All = true;
+		}
+	}
+	if (All)
+		pico_work_all(W);
+#endif
+}
+
+
+static void pico_work_comms (int W) {
+	if (pico_workers[W-1].Epoll >= 0)
+		return pico_wait_comms(W);
+	
+	pico_flush_due(W);
+	pico_work_all(W);
+	float S = pico_wait_time(W, 0.001f);
 	timespec ts = {0, (int)(S*1000000000.0)};
 	nanosleep(&ts, 0); // interuptible sleep	
 }
 
 
+static void pico_epoll_init (int D) { // One epoll per worker, so each only hears about its own comms.
+	pico_worker_count = D;
+#if __linux__
+	for (int i = 0; i < D; i++) {
+		auto& K = pico_workers[i];
+		if (K.Epoll >= 0) continue;
+		int E = epoll_create1(EPOLL_CLOEXEC);
+		int W = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+		epoll_event Ev = {};
+		Ev.events = EPOLLIN|EPOLLET;
+		if (E < 0 or W < 0 or epoll_ctl(E, EPOLL_CTL_ADD, W, &Ev)) {
+			if (E >= 0) close(E);		// fine, we'll just poll then.
+			if (W >= 0) close(W);
+			continue;
+		}
+		K.WakeFD = W;
+		K.Epoll = E;
+	}
+	#if PICO_URING
+	int E = pico_workers[0].Epoll;
+	if (E >= 0 and pico_uring.Init()) {	// one ring. The first worker reaps it for everyone.
+		epoll_event Ev = {};
+		Ev.events = EPOLLIN|EPOLLET;
+		Ev.data.ptr = &pico_uring;
+		if (epoll_ctl(E, EPOLL_CTL_ADD, pico_uring.FD, &Ev) and errno != EEXIST)
+			pico_uring.Close();				// then epoll it is.
+	}
+	#endif
+#endif
+	PicoLister Items;					// forked comms, or ones created before we started.
+	while (auto M = Items.NextComm())
+		M->watch_all();
+}
+
+
 static int pico_any_still_sending () {
 	PicoLister L;
 	int Count = 0;
@@ -1176,9 +3532,15 @@ static void pico_keep_sending () {
 }
 
 
-static void* pico_worker (void* Dummy) {
+static void* pico_worker (void* Index) {
 	char PicoName[] = {'P','i','c','o','W','o','r','k','e','r','0','0',0};
-	int p = ++pico_thread_count;
+	int p = (int)(intptr_t)Index;
+	pico_thread_count++;
+	auto& K = pico_workers[p-1];
+	K.Thread = pthread_self();
+	if (K.Pinned)
+		pico_pin(K);
+	K.Node = pico_node_here();
 	PicoName[10] += p / 10;
 	PicoName[11] += p % 10;
 #if __APPLE__
@@ -1187,14 +3549,14 @@ static void* pico_worker (void* Dummy) {
 	pthread_setname_np(pthread_self(), PicoName);
 #endif 
 
-	if (p!=1) while (true)
-		pico_work_comms();
-	
 	while (true) {
-		pico_work_comms();
-		pico_work_comms();
-		pico_cleanup();
-		pico_work_comms();
+		pico_work_comms(p);
+		pico_work_comms(p);
+		bool Checked = pico_cleanup(p);
+		pico_work_comms(p);
+		if (p != 1) continue;
+		if (Checked)
+			pico_rebalance();
 		if (pico_try_exit())
 			exit(pico_global_conf.ExitCode);
 	}
@@ -1207,18 +3569,34 @@ static bool pico_init (int D) {
 	
 	if (!pico_inited.enter())
 		return true;
+	if (pico_started) {					// the workers just haven't counted themselves yet.
+		pico_inited.leave();
+		return true;
+	}
 	
 	atexit(pico_keep_sending);
-
 	D = std::clamp(D, 1, 6);
+	pico_epoll_init(D);
+
 	pthread_t T = 0;   ;;;/*_*/;;;   // creeping downwards!!
-	bool OK = false;
-	for (int i = pico_thread_count; i < D; i++) {
-		if (!(pthread_create(&T, nullptr, (void*(*)(void*))pico_worker, nullptr) or pthread_detach(T)))
-			OK = true;
+	int Started = 0;
+	for (int i = 1; i <= D; i++) {
+		if (pthread_create(&T, nullptr, (void*(*)(void*))pico_worker, (void*)(intptr_t)i))
+			break;
+		pthread_detach(T);
+		Started = i;
+	}
+	bool OK = Started > 0;
+	if (OK and Started < D) {			// the missing workers' comms go to the ones we have.
+		pico_worker_count = Started;
+		PicoLister Items;
+		while (auto M = Items.NextComm())
+			if (M->Worker > Started)
+				M->move_to(pico_least_loaded());
 	}
 
 	pico_global_conf.LastActivity = PicoNow();
+	pico_started = OK;
 	pico_inited.leave();
 	return OK;
 }
@@ -1244,7 +3622,7 @@ static void pico_kill_all () {
 ///
 
 extern "C" PicoComms* PicoCreate (const char* Name, int BufferByteSize=0)  _pico_code_ (
-/// Creates your message-passer.  Can return `null`, if 64 PicoComms already are in-use.
+/// Creates your message-passer.  Can return `null`, if `PicoMaxComms` PicoComms already are in-use.
 /// Can specify input buffer size. Passing `0` defaults to `PicoDefaultInitSize` (1MB, unless overridden).
 	int ID = pico_list.Reserve();
 	if (ID)
@@ -1255,6 +3633,7 @@ extern "C" PicoComms* PicoCreate (const char* Name, int BufferByteSize=0)  _pico
 extern "C" PicoComms* PicoDestroy (PicoComms* M, const char* Why=nullptr) _pico_code_ (
 /// Destroys the PicoComms object, and reclaims memory. Also closes the other side.
 /// Returns null always. The destruction will happen at a later (very short) time, in another thread.
+/// With `PicoPooledMsgs`, pooled messages you still hold stay valid. Give them back with `PicoFree(nullptr, Msg)`.
 	if (M) M->AskDestroy(Why);
 	return nullptr;
 )
@@ -1329,9 +3708,41 @@ extern "C" void PicoFinish() _pico_code_ (
 
 extern "C" bool PicoSend (PicoComms* M, const char* Msg, int Length, int Policy=PicoSendGiveUp) _pico_code_ (
 /// Sends the message. The data is copied to internal buffers so you do not need to hold onto it after send. If Policy==`PicoSendGiveUp` and there is no buffer space, this function returns `false`. If Policy==`PicoSendCanTimeOut`, and there is no buffer space, PicoSend will block until the timeout is reached. See the ["configuration"](#Configuration) section about how to change the timeout. (You probably should design your programs to slurp up data so fast that blocking isn't necessary.)
+/// Messages bigger than the send-buffer are sent in pieces, and joined back together by the reader. Once the first piece is in, `PicoSend` waits for room for the rest. So it can block, even with `PicoSendGiveUp`.
 	return M->QueueSend(Msg, Length, Policy);
 )
 
+extern "C" bool PicoSendV (PicoComms* M, const struct iovec* Parts, int Count, int Policy=PicoSendGiveUp) _pico_code_ (
+/// Sends one message, made by joining `Count` pieces together. Like `writev()`. Saves you joining a header and payload into a temp buffer yourself.
+/// The message is sent as a whole, or not at all. `Policy` works the same as for `PicoSend()`.
+	return M->QueueSendV(Parts, Count, Policy);
+)
+
+extern "C" bool PicoSendWait (PicoComms* M, int Bytes, float Time=-1) _pico_code_ (
+/// Waits until `Bytes` of space is free in the send-buffer, or `Time` seconds pass. Returns if the space is free.
+/// Passing `-1` uses `SendTimeOut`. Waiting senders sleep, and are woken as the other side reads. So they don't eat up CPU.
+	return M->SendWait(Bytes, Time);
+)
+
+extern "C" char* PicoSendReserve (PicoComms* M, int MaxLen, int Policy=PicoSendGiveUp) _pico_code_ (
+/// Returns space for a message of up to `MaxLen` bytes, inside Pico's send-buffer. Write your message straight into it, then call `PicoSendCommit()`. Saves copying big messages twice.
+/// Returns `null` if there is no space. `Policy` works the same as for `PicoSend()`. Don't send anything else until you have committed.
+/// If the space would wrap around the buffer's end, you get a temporary buffer instead, which is copied on commit. (`PicoMirrorBuffs` avoids this.)
+/// `MaxLen` can be at most the send-buffer's size minus 4 (the header). Anything bigger returns `null` straight away, whatever the `Policy`. Send those with `PicoSend()`, which splits them into pieces. (With `PicoAdaptiveBuffs`, the buffer grows first, up to `MaxBuffSize`.)
+	return M->SendReserve(MaxLen, Policy);
+)
+
+extern "C" bool PicoSendCommit (PicoComms* M, int ActualLen) _pico_code_ (
+/// Sends the message written into `PicoSendReserve()`'s space. `ActualLen` can be less than what you reserved. Pass `-1` to cancel.
+	return M->SendCommit(ActualLen);
+)
+
+extern "C" void PicoFlush (PicoComms* M) _pico_code_ (
+/// Tells the worker to send everything in `M`'s send-buffer now, without waiting for `SendBatch` bytes or `SendDelay` to pass. Returns straight away.
+/// Only needed if you set `SendBatch`. Useful after the last message of a burst.
+	M->Flush();
+)
+
 extern "C" bool PicoSendStr (PicoComms* M, const char* Msg, bool Policy=PicoSendGiveUp) _pico_code_ (
 /// Same as `PicoSend`, just a little simpler to use, if you have a c-string.
 	return M->QueueSend(Msg, (int)strlen(Msg), Policy);
@@ -1339,7 +3750,7 @@ extern "C" bool PicoSendStr (PicoComms* M, const char* Msg, bool Policy=PicoSend
 
 extern "C" void PicoGet (PicoComms* M, PicoMessage* Out, float Time=0) _pico_code_ (
 /// Gets a message if any exist. You can either return immediately if none are queued up, or wait for one to arrive.
-/// Once it returns a PicoMessage, you must `free()` it's `Data` property, after you are finished with it.
+/// Once it returns a PicoMessage, you must `free()` it's `Data` property, after you are finished with it. (Or `PicoFree()` it, if using `PicoPooledMsgs`.)
 /// The string is zero-terminated, but the zero is not included in the reported length.
 	;;;/*_*/;;;  // 🕷️_🕷️
 	*Out = M->Get(Time);
@@ -1351,6 +3762,54 @@ extern "C" PicoMessage PicoGetCpp (PicoComms* M, float Time=0) _pico_code_ (
 	return M->Get(Time);
 );;;/*_*/;;;
 
+extern "C" int PicoGetMany (PicoComms* M, PicoMessage* Out, int Max, float Time=0) _pico_code_ (
+/// Gets up to `Max` messages at once, into `Out`. Returns how many it got. Much faster than calling `PicoGet()` for each one, if you get lots of small messages.
+/// `Time` works the same as for `PicoGet()`, and only waits for the first message.
+/// All the messages are packed into one allocation. So only `free()` (or `PicoFree()`) `Out[0].Data`, and only if this returned more than 0.
+/// Each message is zero-terminated, just like with `PicoGet()`.
+	return M->GetMany(Out, Max, Time);
+)
+
+extern "C" void PicoFree (PicoComms* M, PicoMessage Msg) _pico_code_ (
+/// Frees a message you got from `M`, via `PicoGet()`, `PicoGetCpp()` or `PicoGetMany()` (pass `Out[0]`).
+/// If you set `PicoPooledMsgs` in `M`'s `Options` (before starting it), you must use this instead of `free()`. The buffer goes back to `M`'s pool, so getting messages needs no `malloc()`, once things are warmed up. Messages over 64KB are not pooled.
+/// Without `PicoPooledMsgs`, this is just `free()`. So it is always safe to use.
+/// Pass `null` for `M`, to give back a pooled message after `PicoDestroy(M)`. Only pooled ones!
+	if (M)
+		M->msg_free(Msg.Data);
+	  else
+		PicoMsgPool::Free(Msg.Data);
+)
+
+extern "C" PicoMessage PicoGetView (PicoComms* M, float Time=0) _pico_code_ (
+/// Like `PicoGetCpp()`, except the message is lent to you, straight out of Pico's read-buffer. No `malloc()`, no copy.
+/// Don't `free()` it! Call `PicoRelease()` when you are finished with it. Only one view can be held at a time.
+/// The data is not zero-terminated. Messages that wrap around the buffer's end, are copied for you. (But still need `PicoRelease()`.)
+/// Once you call this, the worker leaves messages in the read-buffer for your next view, instead of copying them out in the background.
+/// `PicoGet()` and `PicoGetMany()` still work, and switch the background copying back on.
+	return M->GetView(Time);
+)
+
+extern "C" int PicoGetInto (PicoComms* M, char* Buf, int Cap, float Time=0) _pico_code_ (
+/// Copies the next message into your `Buf`, so there is nothing to `free()`. Returns the message's length, or 0 if none came.
+/// If the message is bigger than `Cap`, it is left alone, and you get its length negated. So you can make room and try again.
+/// Zero-terminates it, if there is room. `Time` works the same as for `PicoGet()`.
+/// If the message is still in Pico's read-buffer, that is the only copy. If the worker already copied it out in the background, it comes from there.
+/// Unlike `PicoGetView()`, this doesn't stop the background copying.
+	return M->GetInto(Buf, Cap, Time);
+)
+
+extern "C" PicoMessage PicoGetAppend (PicoComms* M, PicoAppenderFn Alloc, void* Obj, float Time=0) _pico_code_ (
+/// Like `PicoGetInto()`, but Pico asks your `Alloc` for space, once it knows the length. Just like `PicoStdOut()`.
+/// If `Alloc` returns `null`, the message is left for later. The data is not zero-terminated.
+	return M->GetAppend(Alloc, Obj, Time, nullptr);
+)
+
+extern "C" void PicoRelease (PicoComms* M) _pico_code_ (
+/// Gives back the message lent by `PicoGetView()`, making room for more data.
+	M->Release();
+)
+
 extern "C" PicoMessage PicoStdOut (PicoComms* M, PicoAppenderFn Alloc=nullptr, void* Obj=nullptr) _pico_code_ (
 /// Reads the captured output of `stdout` (if any). Assumes you created this `PicoComms` via `PicoStartExec()`.
 /// The data is returned via `malloc()`, unless you pass a non-zero value to `Alloc`.
@@ -1420,6 +3879,22 @@ extern "C" bool PicoHasParentSocket () _pico_code_ (
 extern "C" bool PicoInit (int DesiredThreadCount=0) _pico_code_ (
 /// Starts the PicoMsg worker threads.
 	return pico_init(DesiredThreadCount);
+)
+
+extern "C" bool PicoPinWorker (int Worker, const int* CPUs, int Count) _pico_code_ (
+/// Pins the worker-thread `PicoWorker##` (numbered from 1 to 6) to the `Count` CPUs listed in `CPUs`. Pass a `Count` of 0 to unpin it.
+/// Best called before `PicoInit()`, but works anytime. Returns `false` if pinning isn't supported (like on macOS).
+/// On NUMA machines, a comm's buffers are put on its pinned worker's node. Unpinned workers' comms get the node of the thread that started them.
+	if (Worker < 1 or Worker > 6 or Count < 0 or (Count and !CPUs)) return false;
+	auto& K = pico_workers[Worker-1];
+#if __linux__
+	CPU_ZERO(&K.CPUs);
+	for (int i = 0; i < Count; i++)
+		if (CPUs[i] >= 0 and CPUs[i] < CPU_SETSIZE)
+			CPU_SET(CPUs[i], &K.CPUs);
+#endif
+	K.Pinned = Count > 0;
+	return pico_pin(K);
 )    ;;;/*_*/;;;  ;;;/*_*/;;;     ;;;/*_*/;;;   // the final spiders
 
 
@@ -1455,6 +3930,36 @@ extern "C" int PicoError (PicoComms* M) _pico_code_ (
 	return S;
 )
 
+extern "C" void PicoPoolInfo (PicoComms* M, PicoPoolStats* S) _pico_code_ (
+/// Reports how well `M`'s message pool is working. Only useful with `PicoPooledMsgs`. A good `HitRate` is close to 1.
+	*S = {};
+	if (auto P = M->Pool)
+		P->Stats(S);
+)
+
+extern "C" void PicoLatencyInfo (PicoComms* M, PicoLatencyStats* S, bool Reset=false) _pico_code_ (
+/// Reports how long messages took, from being sent, to you getting them from `M`. So that includes time spent in buffers, the kernel, and the unread queue.
+/// Only messages sent with `PicoTimedMsgs` set on the sending comm are timed. Views are timed when you get them, not when you release them.
+/// `Reset` starts counting afresh. Percentiles are accurate to about 12%.
+	PicoLatency::Stats(M->Latency, S, Reset);
+)
+
+extern "C" void PicoCommInfo (PicoComms* M, PicoCommStats* S) _pico_code_ (
+/// Fills `S` with `M`'s counters. Messages and bytes, syscalls, full buffers, and so on. They only ever go up, so take differences for rates.
+/// `PicoGlobals()` adds up the same counters, over every comm.
+	*S = {};
+	M->Stats(S);
+)
+
+extern "C" void PicoLocks (PicoComms* M, PicoLockStats* S) _pico_code_ (
+/// Reports how contended `M`'s internal locks are. High counts mean threads are fighting over this comm.
+/// `InUse`, `SendLock` and `ReadLock` are mostly tried, not waited on, so the worker moves on when they are busy. `GrabLock` is waited on, by `PicoGetMany()` and `PicoGetView()`.
+	S->SendLock = M->SendLock.Contended;
+	S->ReadLock = M->ReadLock.Contended;
+	S->GrabLock = M->GrabLock.Contended;
+	S->InUse    = M->InUse.Contended;
+)
+
 extern "C" PicoGlobalConfig* PicoGlobalConf() _pico_code_ (
 // Returns the global conf struct, which allows you to set important values.
 	return &pico_global_conf;
@@ -1463,7 +3968,16 @@ extern "C" PicoGlobalConfig* PicoGlobalConf() _pico_code_ (
 extern "C" void PicoGlobals (PicoGlobalStats* F) _pico_code_ (
 	F->TimeOutCount = pico_timeout_count;
 	F->OpenSockets  = pico_open_sockets;
-	F->OpenPicos    = __builtin_popcountll(pico_list.Map); 
+	F->OpenPicos    = pico_list.Live();
+	F->Capacity     = pico_list.Count*64;
+	pico_dead_lock.lock();
+	F->All = pico_dead_stats;
+	pico_dead_lock.leave();
+	PicoLister L;
+	while (auto M = L.NextComm()) {
+		PicoCommStats S; M->Stats(&S);
+		PicoComms::AddStats(&F->All, S);
+	}
 );;;/*_*/;;;  //reeeeeeee
 
 #endif
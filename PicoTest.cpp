@@ -7,6 +7,7 @@
 using std::vector;
 #include <iostream>
 #include <bitset>
+#include <algorithm>
 
 
 extern char **environ;
@@ -304,7 +305,7 @@ int ThreadBash (PicoComms* B, void* Fn) {
 		AllSleep = (i&32)==0;
 		bool WillExit = FinishedBash >= ThreadCount;
 		int SockO = pico_open_sockets;
-		uint64_t Map = pico_list.Map;
+		uint64_t Map = pico_list.Maps[0];
 		printf("pico open sockets: %i", SockO);
 		std::cout << ",  Map: " << std::bitset<64>(Map) << std::endl;
 		if (WillExit) break;
@@ -316,6 +317,953 @@ int ThreadBash (PicoComms* B, void* Fn) {
 }
 
 
+int TestView (PicoComms* C) {
+	/// Reads messages in-place, using `PicoGetView()`. The small buffer makes messages wrap around often.
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	PicoCommStats Stats; PicoCommInfo(C, &Stats);
+	if (PicoSendReserve(C, C->Sending->Size, PicoSendCanTimeOut))	// too big to ever fit. That's not a full buffer.
+		return !PicoSay(C, "Reserved more than the buffer");
+	auto Full = Stats.BufferFull; PicoCommInfo(C, &Stats);
+	if (Stats.BufferFull != Full)
+		return !PicoSay(C, "Reserve waited for space that can't exist");
+	int Sent = 0; int Got = 0; char Out[20];
+	while (Got < 10000) {
+		if (Sent < 10000) {
+			int n = TestWrite(Out, Sent);
+			if (Sent & 1) {											// test both ways of sending
+				if (char* R = PicoSendReserve(C, sizeof(Out))) {
+					memcpy(R, Out, n);
+					Sent += PicoSendCommit(C, n);
+				}
+			} else if (PicoSend(C, Out, n)) {
+				Sent++;
+			}
+		}
+		auto V = PicoGetView(C2, (Sent >= 10000)*2.0);
+		if (!V) {
+			if (Sent < 10000) continue;
+			return PicoSay(C2, "View timed out", "", Got) != 0;
+		}
+		char Expected[20]; int n = TestWrite(Expected, Got);
+		if (V.Length != n or memcmp(Expected, V.Data, n))
+			return !PicoSay(C2, "View differed at", "", Got);
+		PicoRelease(C2);
+		Got++;
+	}
+	
+	PicoSend(C, Out, TestWrite(Out, Got));							// going back to `PicoGet()` drains it in the background again.
+	auto M = PicoGetCpp(C2, 2.0);
+	free(M.Data);
+	for (int i = 0; i < 5; i++)
+		PicoSend(C, Out, TestWrite(Out, i));
+	for (int i = 0; i < 200 and !C2->queued(); i++)
+		PicoSleep(0.01);
+	if (!M or !C2->queued())
+		return !PicoSay(C2, "Views stopped the worker for good");
+	for (int i = 0; i < 5; i++)
+		free(PicoGetCpp(C2, 2.0).Data);
+	PicoSay(C2, "Views Passed", "", Got);
+	PicoDestroy(C2, "Finished");
+	return 0;
+}
+
+
+int TestMany (PicoComms* C) {
+	/// Drains bursts of tiny messages, using `PicoGetMany()`.
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	const int Total = 100000;
+	int Sent = 0; int Got = 0; int Calls = 0;
+	char Out[20]; char Expected[20];
+	PicoMessage Many[256];
+	while (Got < Total) {
+		while (Sent < Total) {
+			int n = TestWrite(Out, Sent);
+			iovec Parts[2] = {{Out, 2}, {Out+2, (size_t)n-2}};		// odd ones are sent in two pieces.
+			if (!((Sent&1) ? PicoSendV(C, Parts, 2) : PicoSend(C, Out, n)))
+				break;
+			Sent++;
+		}
+		int n = PicoGetMany(C2, Many, 256, 2.0);
+		if (!n)
+			return !PicoSay(C2, "GetMany timed out", "", Got);
+		Calls++;
+		for (int i = 0; i < n; i++, Got++) {
+			int Len = TestWrite(Expected, Got);
+			if (Many[i].Length != Len or strcmp(Expected, Many[i].Data))
+				return !PicoSay(C2, "GetMany differed at", "", Got);
+		}
+		free(Many[0].Data);
+	}
+	printf("Got %i messages in %i calls\n", Got, Calls);
+	
+	vector<char> Big(1000, 'z');									// an empty message, then packed and timed ones. Those still come in one batch.
+	int Limit = C2->UnreadLimit;
+	C2->UnreadLimit = 1;											// one queued message holds the rest back, in the read-buffer.
+	PicoSend(C, "x", 1);
+	for (int i = 0; i < 200 and !C2->queued(); i++)
+		PicoSleep(0.01);
+	PicoSend(C, "", 0);
+	for (int i = 0; i < 20; i++) {
+		C->Options |= i < 10 ? PicoCompressMsgs : PicoTimedMsgs;
+		Big[0] = 'a' + i;
+		if (!PicoSend(C, &Big[0], (int)Big.size()))
+			return !PicoSay(C, "GetMany packed send failed");
+		C->Options &= ~(PicoTimedMsgs|PicoCompressMsgs);
+	}
+	PicoSleep(0.2);
+	C2->UnreadLimit = Limit;
+	int n = PicoGetMany(C2, Many, 256, 2.0);						// the queued one.
+	if (n > 0) free(Many[0].Data);
+	if (n != 1)
+		return !PicoSay(C2, "GetMany lost the queued one", "", n);
+	n = PicoGetMany(C2, Many, 256, 2.0);
+	bool Same = n == 20;
+	for (int i = 0; Same and i < n; i++)
+		Same = Many[i].Length == 1000 and Many[i].Data[0] == 'a'+i and Many[i].Data[999] == 'z';
+	if (n > 0) free(Many[0].Data);
+	if (!Same)
+		return !PicoSay(C2, "GetMany didn't batch packed and timed ones", "", n);
+	PicoDestroy(C2, "Finished");
+	return 0;
+}
+
+
+int TestCrowd (PicoComms* C) {
+	/// Hundreds of socket-pairs at once. More than fit in one chunk of the comm list.
+	const int N = 200;
+	PicoComms* A[N] = {}; PicoComms* B[N] = {};
+	char Out[20]; char Expected[20];
+	for (int i = 0; i < N; i++) {
+		A[i] = PicoCreate("Crowd", 16*1024);
+		if (!A[i] or !(B[i] = PicoStartChild(A[i])))
+			return !PicoSay(C, "Crowd couldn't start", "", i);
+		A[i]->Noise = 0; B[i]->Noise = 0;
+		int n = TestWrite(Out, i);
+		PicoSend(A[i], Out, n);
+	}
+	
+	PicoGlobalStats G; PicoGlobals(&G);
+	printf("Open Picos: %i, Capacity: %i, Sockets: %i\n", G.OpenPicos, G.Capacity, G.OpenSockets);
+	if (G.OpenPicos < N*2+1 or G.Capacity < G.OpenPicos)
+		return !PicoSay(C, "Crowd miscounted", "", G.OpenPicos);
+	
+	for (int i = 0; i < N; i++) {
+		auto Msg = PicoGetCpp(B[i], 2.0);
+		int n = TestWrite(Expected, i);
+		if (!Msg or Msg.Length != n or strcmp(Msg.Data, Expected))
+			return !PicoSay(C, "Crowd lost a message", "", i);
+		free(Msg.Data);
+		PicoDestroy(A[i]); PicoDestroy(B[i]);
+	}
+	PicoSay(C, "Crowd Passed", "", N);
+	return 0;
+}
+
+
+int TestShards (PicoComms* C) {
+	/// Many busy pairs, spread across 4 workers. Each comm is only worked by its owner.
+	int CPUs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	for (int w = 1; w <= 4; w++) {
+		int CPU = (w-1) % CPUs;
+		PicoPinWorker(w, &CPU, 1);
+	}
+	PicoInit(4);
+	const int N = 16; const int Total = 20000;
+	PicoComms* A[N] = {}; PicoComms* B[N] = {};
+	int Sent[N] = {}; int Got[N] = {};
+	char Out[20]; char Expected[20];
+	for (int i = 0; i < N; i++) {
+		A[i] = PicoCreate("Shard", 64*1024);
+		if (!A[i] or !(B[i] = PicoStartChild(A[i])))
+			return !PicoSay(C, "Shard couldn't start", "", i);
+		A[i]->Noise = 0; B[i]->Noise = 0;
+	}
+	
+	for (int Done = 0; Done < N;) {
+		Done = 0;
+		for (int i = 0; i < N; i++) {
+			while (Sent[i] < Total and PicoSend(A[i], Out, TestWrite(Out, Sent[i])))
+				Sent[i]++;
+			while (auto Msg = PicoGetCpp(B[i], Got[i] < Sent[i] ? 0.01 : 0)) {
+				int n = TestWrite(Expected, Got[i]++);
+				if (Msg.Length != n or strcmp(Msg.Data, Expected))
+					return !PicoSay(C, "Shard differed at", "", Got[i]);
+				free(Msg.Data);
+			}
+			Done += Got[i] >= Total;
+		}
+	}
+	
+	for (int w = 0; w < pico_worker_count; w++)
+		printf("Worker %i owns %i comms\n", w+1, (int)pico_workers[w].Comms);
+	PicoLockStats All = {};
+	for (int i = 0; i < N; i++) {
+		PicoLockStats L; PicoLocks(B[i], &L);
+		All.SendLock += L.SendLock; All.ReadLock += L.ReadLock; All.GrabLock += L.GrabLock; All.InUse += L.InUse;
+		PicoDestroy(A[i]); PicoDestroy(B[i]);
+	}
+	printf("Contended: Send %u, Read %u, Grab %u, InUse %u\n", All.SendLock, All.ReadLock, All.GrabLock, All.InUse);
+	PicoSay(C, "Shards Passed", "", N);
+	return 0;
+}
+
+
+int TestHuge (PicoComms* C) {
+	/// Messages many times bigger than the buffers. They get sent in pieces, and joined back together.
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	vector<char> Big(4*1024*1024 + 3);
+	for (size_t i = 0; i < Big.size(); i++)
+		Big[i] = (char)hash((uint)i);
+	char Out[20]; char Expected[20];
+	for (int i = 0; i < 12; i++) {
+		int n = (int)(Big.size() >> (i%6));
+		if (i & 1) {
+			iovec Parts[2] = {{&Big[0], 5}, {&Big[5], (size_t)n-5}};
+			if (!PicoSendV(C, Parts, 2, PicoSendCanTimeOut))
+				return !PicoSay(C, "Huge SendV failed", "", n);
+		} else if (!PicoSend(C, &Big[0], n, PicoSendCanTimeOut)) {
+			return !PicoSay(C, "Huge Send failed", "", n);
+		}
+		int n2 = TestWrite(Out, i);
+		PicoSend(C, Out, n2, PicoSendCanTimeOut);
+		
+		auto Msg = (i >= 6) ? PicoGetView(C2, 5.0) : PicoGetCpp(C2, 5.0);	// views join pieces too.
+		if (Msg.Length != n or memcmp(Msg.Data, &Big[0], n))
+			return !PicoSay(C2, "Huge differed at", "", i);
+		(i >= 6) ? PicoRelease(C2) : free(Msg.Data);
+		
+		Msg = PicoGetCpp(C2, 5.0);
+		TestWrite(Expected, i);
+		if (!Msg or strcmp(Msg.Data, Expected))
+			return !PicoSay(C2, "Huge lost the small one at", "", i);
+		free(Msg.Data);
+	}
+	PicoSay(C2, "Huge Passed");
+	PicoDestroy(C2, "Finished");
+	return 0;
+}
+
+
+int TestAdapt (PicoComms* C) {
+	/// Bursts make the buffers grow. Then a quiet spell makes them shrink back.
+	C->Options |= PicoAdaptiveBuffs;
+	C->MaxBuffSize = 1024*1024;
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	int Start = C->Sending->Size;
+	char Out[20]; char Expected[20];
+	int Sent = 0; int Got = 0;
+	for (int Burst = 0; Burst < 20; Burst++) {
+		for (int i = 0; i < 5000; i++)						// much more than 16KB, without waiting.
+			if (PicoSend(C, Out, TestWrite(Out, Sent)))
+				Sent++;
+		while (Got < Sent) {
+			auto Msg = PicoGetCpp(C2, 2.0);
+			TestWrite(Expected, Got++);
+			if (!Msg or strcmp(Msg.Data, Expected))
+				return !PicoSay(C2, "Adapt differed at", "", Got);
+			free(Msg.Data);
+		}
+	}
+	int Grown = C->Sending->Size;
+	printf("Sent %i of %i. Send buffer: %i --> %i, Read buffer: %i\n", Sent, 20*5000, Start, Grown, C2->Reading->Size);
+	if (Grown <= Start)
+		return !PicoSay(C, "Adapt didn't grow");
+	
+	for (int i = 0; i < 40 and C->Sending->Size > C->MinBuffSize; i++) {
+		PicoSendStr(C, "quiet");							// the sender shrinks its own buffer, when it next sends.
+		free(PicoGetCpp(C2, 1.0).Data);
+		PicoSleep(0.1);
+	}
+	printf("After quiet: %i\n", C->Sending->Size);
+	if (C->Sending->Size >= Grown)
+		return !PicoSay(C, "Adapt didn't shrink");
+	PicoSay(C2, "Adapt Passed");
+	PicoDestroy(C2, "Finished");
+	return 0;
+}
+
+
+int TestPool (PicoComms* C) {
+	/// Received messages come from a pool, and go back with `PicoFree()`.
+	/// One message at a time, so only a couple of blocks are ever out. That makes the counts exact.
+	C->Options |= PicoPooledMsgs;
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	const int Total = 20000;
+	vector<char> Big(100*1024);
+	char Out[20]; char Expected[20];
+	PicoMessage Many[64];
+	unsigned int Bigs = 0;
+	for (int Sent = 0; Sent < Total; Sent++) {
+		if (Sent % 1000 == 0) {										// too big to pool
+			if (!PicoSend(C, &Big[0], (int)Big.size(), PicoSendCanTimeOut))
+				return !PicoSay(C, "Pool big send failed");
+			auto M = PicoGetCpp(C2, 2.0);
+			if (M.Length != (int)Big.size())
+				return !PicoSay(C2, "Pool lost a big one", "", Sent);
+			PicoFree(C2, M);
+			Bigs++;
+		}
+		if (!PicoSend(C, Out, TestWrite(Out, Sent), PicoSendCanTimeOut))
+			return !PicoSay(C, "Pool send failed");
+		int n = (Sent & 1) ? PicoGetMany(C2, Many, 64, 2.0) : (Many[0] = PicoGetCpp(C2, 2.0)).Length > 0;
+		if (n != 1)
+			return !PicoSay(C2, "Pool timed out", "", Sent);
+		int Len = TestWrite(Expected, Sent);
+		if (Many[0].Length != Len or strcmp(Expected, Many[0].Data))
+			return !PicoSay(C2, "Pool differed at", "", Sent);
+		PicoFree(C2, Many[0]);
+	}
+	PicoPoolStats P; PicoPoolInfo(C2, &P);
+	printf("Hits: %u, Misses: %u, TooBig: %u, Cached: %i, HitRate: %.3f\n", P.Hits, P.Misses, P.TooBig, P.CachedBytes, P.HitRate);
+	if (P.Misses > PicoMsgPool::Classes)
+		return !PicoSay(C2, "Pool missed too often");
+	if (P.TooBig != Bigs)
+		return !PicoSay(C2, "Pool miscounted big ones", "", P.TooBig);
+	if (P.Hits < Total - P.Misses)
+		return !PicoSay(C2, "Pool didn't reuse blocks");
+
+	PicoSend(C, Out, TestWrite(Out, 1));							// held past PicoDestroy()
+	auto Held = PicoGetCpp(C2, 2.0);
+	PicoDestroy(C2, "Finished");
+	for (int i = 0; i < 200 and C2->Pool; i++)						// it doesn't wait for us.
+		PicoSleep(0.01);
+	if (C2->Pool)
+		return !PicoSay(C, "Pool kept the comm alive");
+	if (!Held or strcmp(Held.Data, Out))
+		return !PicoSay(C, "Pool lost the held one");
+	PicoFree(nullptr, Held);
+	PicoSay(C, "Pool Passed");
+	return 0;
+}
+
+
+static char* TestGrow (void* Obj, int Length) {
+	auto V = (vector<char>*)Obj;
+	V->resize(Length);
+	return &(*V)[0];
+}
+
+int TestInto (PicoComms* C) {
+	/// Messages read straight into our own memory, with `PicoGetInto()` and `PicoGetAppend()`.
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	const int Total = 20000;
+	vector<char> Big(200*1024);
+	for (int i = 0; i < (int)Big.size(); i++)
+		Big[i] = (char)(i * 7);
+	char Out[20]; char Expected[20]; char Buf[64];
+	vector<char> Grown;
+	int Sent = 0; int Got = 0;
+	while (Got < Total) {
+		int Upto = Got < Total/2 ? Total/2 : Total;					// empty before the big one.
+		while (Sent < Upto and PicoSend(C, Out, TestWrite(Out, Sent)))
+			Sent++;
+		if (Got == Total/2 and Sent == Got) {
+			if (!PicoSend(C, &Big[0], (int)Big.size(), PicoSendCanTimeOut))
+				return !PicoSay(C, "Big send failed");
+			int n = PicoGetInto(C2, Buf, sizeof(Buf), 5.0);				// too small, so stays put.
+			if (n != -(int)Big.size())
+				return !PicoSay(C2, "Into should have refused", "", n);
+			auto M = PicoGetAppend(C2, TestGrow, &Grown, 1.0);
+			if (M.Length != (int)Big.size() or Grown != Big)
+				return !PicoSay(C2, "Big append differed");
+		}
+		int Len = TestWrite(Expected, Got);
+		if (Got & 1) {
+			int n = PicoGetInto(C2, Buf, sizeof(Buf), 2.0);
+			if (n <= 0)
+				return !PicoSay(C2, "Into timed out", "", Got);
+			if (n != Len or strcmp(Expected, Buf))
+				return !PicoSay(C2, "Into differed at", "", Got);
+		} else {
+			auto M = PicoGetAppend(C2, TestGrow, &Grown, 2.0);
+			if (M.Length != Len or memcmp(Expected, M.Data, Len))
+				return !PicoSay(C2, "Append differed at", "", Got);
+		}
+		Got++;
+	}
+	if (C2->ZeroCopy)												// no view was held. So the worker should still copy them out.
+		return !PicoSay(C2, "Into stopped the background copying");
+	PicoSay(C2, "Into Passed");
+	PicoDestroy(C2, "Finished");
+	return 0;
+}
+
+
+static int TestText (vector<char>& V, int n, int Seed) {
+	static const char* Words[] = {"pico ", "message ", "worker ", "buffer ", "socket ", "result, ", "done.\n"};
+	V.clear();
+	while ((int)V.size() < n) {
+		const char* W = Words[hash(Seed++) % 7];
+		V.insert(V.end(), W, W + strlen(W));
+	}
+	V.resize(n);
+	return n;
+}
+
+int TestPack (PicoComms* C) {
+	/// Compressible messages get compressed, and come back out the same. However we get them.
+	C->Options |= PicoCompressMsgs;
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	const int Sizes[] = {100, 300, 4000, 12000, 100000, 1000000};
+	vector<char> Text; vector<char> Grown; vector<char> Noise(5000);
+	for (int i = 0; i < (int)Noise.size(); i++)
+		Noise[i] = (char)hash(i);
+	char Buf[16*1024];
+	for (int i = 0; i < 24; i++) {
+		int n = TestText(Text, Sizes[i % 6], i);
+		const char* Src = &Text[0];
+		if (i % 5 == 4) {Src = &Noise[0]; n = (int)Noise.size();}		// won't compress, so goes plain.
+		iovec Parts[2] = {{(void*)Src, 7}, {(void*)(Src+7), (size_t)n-7}};
+		bool OK = (i & 1) ? PicoSend(C, Src, n, PicoSendCanTimeOut) : PicoSendV(C, Parts, 2, PicoSendCanTimeOut);
+		if (!OK)
+			return !PicoSay(C, "Pack send failed", "", i);
+		
+		PicoMessage M = {};
+		int Way = (i / 6) & 3;
+		if (Way == 0) M = PicoGetCpp(C2, 5.0);
+		if (Way == 1) M = PicoGetView(C2, 5.0);
+		if (Way == 2) PicoGetMany(C2, &M, 1, 5.0);
+		if (Way == 3 and n <= (int)sizeof(Buf)) M = {Buf, PicoGetInto(C2, Buf, sizeof(Buf), 5.0)};
+		if (Way == 3 and n > (int)sizeof(Buf)) M = PicoGetAppend(C2, TestGrow, &Grown, 5.0);
+		if (M.Length != n or memcmp(M.Data, Src, n))
+			return !PicoSay(C2, "Pack differed at", "", i);
+		if (Way == 0 or Way == 2) free(M.Data);
+		if (Way == 1) PicoRelease(C2);
+	}
+	PicoSay(C2, "Pack Passed");
+	PicoDestroy(C2, "Finished");
+	return 0;
+}
+
+int TestBatch (PicoComms* C) {
+	/// Tiny messages are held back, and sent in batches. The deadline, or `PicoFlush()`, sends the stragglers.
+	C->SendBatch = 8*1024;
+	C->SendDelay = 2000;
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	const int Total = 100000;
+	char Out[20]; char Expected[20];
+	PicoMessage Many[256];
+	int Sent = 0; int Got = 0;
+	while (Got < Total) {
+		while (Sent < Total and PicoSend(C, Out, TestWrite(Out, Sent)))
+			Sent++;
+		int n = PicoGetMany(C2, Many, 256, 2.0);
+		if (!n)
+			return !PicoSay(C2, "Batch timed out", "", Got);
+		for (int i = 0; i < n; i++) {
+			int Len = TestWrite(Expected, Got++);
+			if (Many[i].Length != Len or strcmp(Expected, Many[i].Data))
+				return !PicoSay(C2, "Batch differed at", "", Got);
+		}
+		free(Many[0].Data);
+	}
+	
+	PicoDate T = PicoNow();
+	PicoSendStr(C, "straggler");									// the deadline sends this one.
+	auto M = PicoGetCpp(C2, 1.0);
+	float Late = (PicoNow() - T) * (1.0f/65536.0f);
+	if (!M or Late > 0.1f)
+		return !PicoSay(C2, "Batch deadline missed");
+	free(M.Data);
+	
+	C->SendDelay = 5000000;											// now only a flush sends it.
+	PicoSendStr(C, "flushed");
+	if ((M = PicoGetCpp(C2, 0.1)))
+		return !PicoSay(C2, "Batch didn't hold back", M.Data);
+	PicoFlush(C);
+	M = PicoGetCpp(C2, 1.0);
+	if (!M or strcmp(M.Data, "flushed"))
+		return !PicoSay(C2, "Batch flush failed");
+	free(M.Data);
+	printf("Straggler took: %.2fms\n", Late*1000.0f);
+	PicoSay(C2, "Batch Passed");
+	PicoDestroy(C2, "Finished");
+	return 0;
+}
+
+int TestTimed (PicoComms* C) {
+	/// Messages carry their send-time, so we can see how long they took to be got.
+	C->Options |= PicoTimedMsgs;
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	const int Total = 20000;
+	vector<char> Big(100*1024);
+	for (int i = 0; i < (int)Big.size(); i++)
+		Big[i] = (char)hash(i);
+	char Out[20]; char Expected[20];
+	int Sent = 0; int Got = 0; int Bigs = 0;
+	while (Got < Total) {
+		if (Got == Total/2 and Sent == Got and !Bigs++) {			// one in pieces too.
+			if (!PicoSend(C, &Big[0], (int)Big.size(), PicoSendCanTimeOut))
+				return !PicoSay(C, "Timed big send failed");
+		}
+		int Upto = Got < Total/2 ? Total/2 : Total;					// empty before the big one.
+		while (Sent < Upto) {
+			int n = TestWrite(Out, Sent);
+			iovec Parts[2] = {{Out, 1}, {Out+1, (size_t)n-1}};
+			if (!((Sent&1) ? PicoSendV(C, Parts, 2) : PicoSend(C, Out, n)))
+				break;
+			Sent++;
+		}
+		bool View = Got % 3 == 2;
+		PicoMessage M = View ? PicoGetView(C2, 2.0) : PicoGetCpp(C2, 2.0);
+		if (!M)
+			return !PicoSay(C2, "Timed timed out", "", Got);
+		if (M.Length == (int)Big.size()) {
+			if (memcmp(M.Data, &Big[0], M.Length))
+				return !PicoSay(C2, "Timed big differed");
+		} else {
+			int Len = TestWrite(Expected, Got++);
+			if (M.Length != Len or strcmp(Expected, M.Data))
+				return !PicoSay(C2, "Timed differed at", "", Got);
+		}
+		View ? PicoRelease(C2) : free(M.Data);
+	}
+	PicoLatencyStats L; PicoLatencyInfo(C2, &L, true);
+	printf("Timed: %u, p50: %.1fus, p99: %.1fus, p999: %.1fus, max: %.1fus\n", L.Count, L.P50, L.P99, L.P999, L.Max);
+	if (L.Count != Total + 1 or L.P50 <= 0 or L.P50 > L.P99 or L.P99 > L.P999 or L.P999 > L.Max)
+		return !PicoSay(C2, "Timed stats wrong");
+	PicoLatencyInfo(C2, &L);
+	if (L.Count)
+		return !PicoSay(C2, "Timed stats didn't reset");
+	PicoSay(C2, "Timed Passed");
+	PicoDestroy(C2, "Finished");
+	return 0;
+}
+
+int TestCounts (PicoComms* C) {
+	/// Every comm counts its messages, bytes and syscalls. `PicoGlobals()` adds them all up.
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	const int Total = 50000;
+	char Out[20]; char Expected[20];
+	int Sent = 0; int Got = 0; int Full = 0;
+	uint64_t Bytes = 0;
+	while (Got < Total) {
+		while (Sent < Total) {
+			int n = TestWrite(Out, Sent);
+			if (!PicoSend(C, Out, n)) {Full++; break;}
+			Bytes += n;
+			Sent++;
+		}
+		auto M = PicoGetCpp(C2, 2.0);
+		TestWrite(Expected, Got++);
+		if (!M or strcmp(M.Data, Expected))
+			return !PicoSay(C2, "Counts differed at", "", Got);
+		free(M.Data);
+	}
+	
+	PicoCommStats S; PicoCommInfo(C, &S);
+	PicoCommStats R; PicoCommInfo(C2, &R);
+	printf("Sent: %llu msgs, %llu bytes, %llu calls, %llu full, peak %i. Got: %llu msgs, %llu calls, %llu EAGAIN, peak %i\n",
+		(unsigned long long)S.MsgsSent, (unsigned long long)S.BytesSent, (unsigned long long)S.SendCalls, (unsigned long long)S.BufferFull, S.SendingPeak,
+		(unsigned long long)R.MsgsGot, (unsigned long long)R.ReadCalls, (unsigned long long)R.Again, R.ReadingPeak);
+	if (S.MsgsSent != Total or S.BytesSent != Bytes or R.MsgsGot != Total or R.BytesGot != Bytes)
+		return !PicoSay(C2, "Counts don't add up");
+	if (!S.SendCalls or !R.ReadCalls or S.SendCalls > Total or !S.SendingPeak or !R.ReadingPeak)
+		return !PicoSay(C2, "Counts missed the syscalls");
+	if (Full and !S.BufferFull)
+		return !PicoSay(C2, "Counts missed a full buffer");
+	
+	PicoDestroy(C2, "Finished");
+	PicoGlobalStats G; PicoGlobals(&G);								// still counts the destroyed one.
+	if (G.All.MsgsGot < Total or G.All.MsgsSent < Total)
+		return !PicoSay(C, "Counts lost in the globals");
+	PicoSay(C, "Counts Passed");
+	return 0;
+}
+
+struct WaitReader {
+	PicoComms*			M;
+	std::atomic_int		Go;			// 1 = drain it, 0 = leave it full, -1 = finish.
+	int					Got;
+	bool				Bad;
+};
+
+static void* TestWaitRead (WaitReader* R) {
+	while (R->Go >= 0) {
+		if (!R->Go) {PicoSleep(0.001); continue;}
+		PicoSleep(0.1);												// so the sender is asleep, before we make room.
+		while (auto M = PicoGetView(R->M, 0.2)) {
+			R->Bad |= M.Length != 1024 or M.Data[0] != (char)R->Got;
+			R->Got++;
+			PicoRelease(R->M);
+		}
+		R->Go = 0;
+	}
+	return nullptr;
+}
+
+int TestWait (PicoComms* C) {
+	/// Fills the send-buffer, then checks `PicoSendWait()` times out, and wakes once a reader drains it.
+	/// Then does the same for a `PicoSendCanTimeOut` sender.
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	PicoGetView(C2);												// views only. So nothing drains, until our reader does.
+	WaitReader R{};
+	R.M = C2;
+	pthread_t T = 0;
+	if (pthread_create(&T, nullptr, (void*(*)(void*))TestWaitRead, &R))
+		return -1;
+	
+	vector<char> Msg(1024);
+	int Sent = 0;
+	for (int Round = 0; Round < 2; Round++) {
+		while (true) {												// fill it, past the socket too.
+			while ((Msg[0] = (char)Sent), PicoSend(C, &Msg[0], (int)Msg.size()))
+				Sent++;
+			PicoDate Start = PicoNow();
+			if (PicoSendWait(C, (int)Msg.size() + PicoMsgInfo, 0.2))
+				continue;
+			if (PicoNow() - Start < 64*1024/8)
+				return !PicoSay(C, "SendWait didn't wait");
+			break;
+		}
+		
+		R.Go = 1;
+		PicoDate Start = PicoNow();
+		bool OK;
+		if (Round == 0) {
+			OK = PicoSendWait(C, 8*1024, 5.0);
+		} else {
+			Msg[0] = (char)Sent;
+			OK = PicoSend(C, &Msg[0], (int)Msg.size(), PicoSendCanTimeOut);
+			Sent += OK;
+		}
+		if (!OK)
+			return !PicoSay(C, Round ? "Blocked send never woke" : "SendWait never woke");
+		if (PicoNow() - Start < 64*1024/20)
+			return !PicoSay(C, Round ? "Blocked send didn't block" : "SendWait didn't block");
+		while (R.Go)
+			PicoSleep(0.01);
+	}
+	
+	R.Go = -1;
+	pthread_join(T, nullptr);
+	PicoCommStats S; PicoCommInfo(C, &S);
+	printf("Sent: %i, Got: %i, Blocked: %.3fs\n", Sent, R.Got, S.BlockedTime);
+	if (R.Bad or R.Got != Sent)
+		return !PicoSay(C2, "Wait lost messages", "", R.Got);
+	if (S.BlockedTime <= 0)
+		return !PicoSay(C, "Wait didn't count the blocked time");
+	PicoDestroy(C2, "Finished");
+	PicoSay(C, "Wait Passed");
+	return 0;
+}
+
+int TestIdle (PicoComms* C) {
+	/// Leaves a socket comm quiet for a while, then checks the first message still arrives right away.
+	/// The workers sleep in epoll, so they wake when data comes in, not when a timer runs out.
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	for (int i = 0; i < 4; i++) {
+		PicoSleep(0.75);											// long enough for a polling worker to back off.
+		int64_t Start = pico_now_ns();
+		if (!PicoSendStr(C, "wake up"))
+			return !PicoSay(C, "Idle send failed");
+		auto M = PicoGetCpp(C2, 2.0);
+		double Took = (pico_now_ns() - Start) / 1e6;
+		bool Same = M and !strcmp(M.Data, "wake up");
+		free(M.Data);
+		printf("Idle wake %i: %.3fms\n", i, Took);
+		if (!Same)
+			return !PicoSay(C2, "Idle message lost");
+		if (Took > 100.0)
+			return !PicoSay(C2, "Idle worker woke late");
+	}
+	PicoDestroy(C2, "Finished");
+	PicoSay(C, "Idle Passed");
+	return 0;
+}
+
+static void TestWakeEcho (PicoComms* M, uint Mode, const char** Args) {
+	while (auto Msg = PicoGetCpp(M, 5.0)) {
+		bool Quit = Msg.Data[0] == 'Q';
+		bool OK = PicoSend(M, Msg.Data, Msg.Length);
+		free(Msg.Data);
+		if (Quit or !OK) break;
+	}
+}
+
+int TestWake (PicoComms* C) {
+	/// Ping-pongs with a thread, both sides in blocking gets. They sleep on a futex, that wakes when the message lands.
+	/// Polling every 1ms would put the typical round trip at a millisecond or more.
+	if (!PicoStartThread(C, TestWakeEcho)) return -1;
+	const int Total = 2000;
+	vector<int64_t> Times;
+	for (int i = -20; i < Total; i++) {							// a few to warm up.
+		int64_t Start = pico_now_ns();
+		if (!PicoSend(C, "ping", 5))
+			return !PicoSay(C, "Wake send failed");
+		auto M = PicoGetCpp(C, 2.0);
+		bool Same = M and !strcmp(M.Data, "ping");
+		free(M.Data);
+		if (!Same)
+			return !PicoSay(C, "Wake lost a pong", "", i);
+		if (i >= 0)
+			Times.push_back(pico_now_ns() - Start);
+	}
+	PicoSend(C, "Q", 2);
+	free(PicoGetCpp(C, 2.0).Data);
+	
+	std::sort(Times.begin(), Times.end());
+	double Median = Times[Total/2] / 1e3;
+	printf("Wake round trips: median %.1fus, p99 %.1fus\n", Median, Times[Total*99/100] / 1e3);
+	if (Median > 500.0)
+		return !PicoSay(C, "Blocking gets wake too slowly");
+	PicoSay(C, "Wake Passed");
+	return 0;
+}
+
+static int TestBacklogBytes (PicoComms* M) {
+	auto Q = M->Unread.load();
+	return Q ? (int)Q->Bytes : 0;
+}
+
+int TestBacklog (PicoComms* C) {
+	/// Sends far more than the 16KB buffers hold, while nobody reads. The worker keeps draining the socket
+	/// into the unread queue, up to `UnreadLimit`. Then it stops, and the sender gets pushed back on.
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	const int Limit = 64*1024;
+	C2->UnreadLimit = Limit;
+	char Msg[1000];
+	int Sent = 0;
+	for (; Sent < 40; Sent++) {										// 40KB. Only fits if the worker drains it.
+		memset(Msg, Sent, sizeof(Msg));
+		if (!PicoSend(C, Msg, sizeof(Msg), PicoSendCanTimeOut))
+			return !PicoSay(C, "Backlog send blocked");
+	}
+	for (int i = 0; i < 200 and TestBacklogBytes(C2) < Sent*1000; i++)
+		PicoSleep(0.01);
+	if (TestBacklogBytes(C2) != Sent*1000)
+		return !PicoSay(C2, "Backlog wasn't queued", "", TestBacklogBytes(C2));
+	
+	PicoDate Quiet = PicoNow();
+	while (PicoNow() - Quiet < 64*1024/2) {							// till it's been full for half a second.
+		memset(Msg, Sent, sizeof(Msg));
+		if (PicoSend(C, Msg, sizeof(Msg))) {
+			Sent++;
+			Quiet = PicoNow();
+		} else {
+			PicoSleep(0.01);
+		}
+	}
+	int Queued = TestBacklogBytes(C2);
+	printf("Backlog: sent %i, queued %i bytes, limit %i\n", Sent, Queued, Limit);
+	if (Queued < Limit or Queued > Limit + (int)sizeof(Msg))
+		return !PicoSay(C2, "Backlog ignored UnreadLimit", "", Queued);
+	
+	for (int Got = 0; Got < Sent; Got++) {
+		auto M = PicoGetCpp(C2, 2.0);
+		bool Same = M.Length == sizeof(Msg) and M.Data[0] == (char)Got and M.Data[999] == (char)Got;
+		free(M.Data);
+		if (!Same)
+			return !PicoSay(C2, "Backlog lost a message", "", Got);
+	}
+	PicoDestroy(C2, "Finished");
+	PicoSay(C, "Backlog Passed");
+	return 0;
+}
+
+int TestWrap (PicoComms* C) {
+	/// Sends messages that wrap around the end of the 16KB buffers. Each should still take one send and one read
+	/// that gets data, as both halves go in one `sendmsg`/`recvmsg`.
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	vector<char> Msg(12000);
+	int Wraps = 0;
+	for (int i = 0; i < 20; i++) {
+		int n = (i & 1) ? 8000 : 12000;								// 12K then 8K can't both fit before the end.
+		memset(&Msg[0], 'a'+i, n);
+		PicoCommStats S0; PicoCommInfo(C, &S0);
+		PicoCommStats R0; PicoCommInfo(C2, &R0);
+		if (!PicoSend(C, &Msg[0], n))
+			return !PicoSay(C, "Wrap send failed");
+		auto M = PicoGetCpp(C2, 2.0);
+		bool Same = M.Length == n and M.Data[0] == 'a'+i and M.Data[n-1] == 'a'+i;
+		free(M.Data);
+		if (!Same)
+			return !PicoSay(C2, "Wrap lost a message", "", i);
+		PicoCommStats S1; PicoCommInfo(C, &S1);
+		PicoCommStats R1; PicoCommInfo(C2, &R1);
+		int Sends = (int)(S1.SendCalls - S0.SendCalls);
+		int Reads = (int)(R1.ReadCalls - R0.ReadCalls - (R1.Again - R0.Again));	// a sweep's EAGAIN read isn't this message's.
+		if (i & 1) Wraps++;
+		if (Sends != 1 or Reads != 1)
+			return !PicoSay(C2, "Wrap took too many syscalls", "", Sends*100 + Reads);
+	}
+	printf("Wrap: %i wrapped messages, one syscall each way\n", Wraps);
+	PicoDestroy(C2, "Finished");
+	PicoSay(C, "Wrap Passed");
+	return 0;
+}
+
+int TestRing () {
+	/// With `PICO_URING`: shrinks the io_uring rings, and holds the reaper back while a dozen comms get busy.
+	/// So completions overflow, and must be flushed. Three workers, so most completions get handed to another worker.
+#if PICO_URING and __linux__
+	pico_uring.SQSize = 8;
+	pico_uring.CQSize = 8;
+	PicoInit(3);
+	const int Pairs = 12;
+	PicoComms* A[Pairs]; PicoComms* B[Pairs];
+	for (int i = 0; i < Pairs; i++) {
+		A[i] = PicoCreate("RingA", 16*1024);
+		B[i] = A[i] ? PicoStartChild(A[i]) : nullptr;
+		if (!B[i]) return -1;
+	}
+	if (pico_uring.FD < 0) {
+		puts("io_uring isn't available here. Skipped.");
+		return 0;
+	}
+	for (int i = 0; i < Pairs; i++)									// posted by `watch()`, before any traffic.
+		if (!B[i]->Ops or B[i]->Ops[1].State != 1)
+			return !PicoSay(B[i], "Ring didn't post the first receive");
+	
+	char Out[20]; char Expected[20];
+	for (int Round = 0; Round < 4; Round++) {
+		pico_uring.ReapLock.lock();									// nobody reaps, till we're done sending.
+		for (int i = 0; i < Pairs; i++) {
+			auto From = (Round & 1) ? B[i] : A[i];
+			if (!PicoSend(From, Out, TestWrite(Out, Round*Pairs + i)))
+				return !PicoSay(From, "Ring send failed");
+		}
+		PicoSleep(0.1);
+		pico_uring.ReapLock.leave();
+		pico_ring_reap(0);											// not a worker. So it all gets handed over.
+		for (int i = 0; i < Pairs; i++) {
+			auto To = (Round & 1) ? A[i] : B[i];
+			auto M = PicoGetCpp(To, 2.0);
+			TestWrite(Expected, Round*Pairs + i);
+			bool Same = M and !strcmp(M.Data, Expected);
+			free(M.Data);
+			if (!Same)
+				return !PicoSay(To, "Ring lost a message", "", Round*Pairs + i);
+		}
+	}
+	
+	printf("Ring overflowed %u times\n", (unsigned)pico_uring.Overflows);
+	if (!pico_uring.Overflows)
+		return !PicoSay(A[0], "Ring never overflowed");
+	for (int i = 0; i < Pairs; i++) {
+		PicoDestroy(B[i]);
+		PicoDestroy(A[i]);
+	}
+	puts("Ring Passed");
+#else
+	puts("Built without PICO_URING. Skipped.");
+#endif
+	return 0;
+}
+
+int TestLastWords (PicoComms* C) {
+	/// A shared-memory child sends its last messages, and exits straight away. The parent must still get them all,
+	/// even though the socket closed first. A tiny `UnreadLimit` keeps most of them in the read-buffer till then.
+	C->Options |= PicoSharedMem;
+	C->UnreadLimit = 1;
+	int PID = PicoStartFork(C, "LastWords");
+	if (PID < 0) return -PID;
+	const int Total = 200;
+	char Out[20]; char Expected[20];
+	if (!PID) {
+		for (int i = 0; i < Total; i++)
+			if (!PicoSend(C, Out, TestWrite(Out, i), PicoSendCanTimeOut))
+				_exit(1);
+		_exit(0);
+	}
+	
+	PicoSleep(0.5);													// the child is long gone.
+	int Got = 0;
+	while (PicoCanGet(C)) {											// till it says there's nothing left.
+		auto M = PicoGetCpp(C, 2.0);
+		if (!M) break;
+		TestWrite(Expected, Got++);
+		bool Same = !strcmp(M.Data, Expected);
+		free(M.Data);
+		if (!Same)
+			return !PicoSay(C, "Last words differed", "", Got);
+	}
+	if (Got != Total)
+		return !PicoSay(C, "Last words lost", "", Got);
+	if (PicoCanGet(C))
+		return !PicoSay(C, "Last words never closed");
+	PicoSay(C, "LastWords Passed");
+	return 0;
+}
+
+static void* TestResizeSend (PicoComms* C) {
+	char Out[20];
+	int Sent = 0;
+	for (int Burst = 0; Burst < 3; Burst++) {
+		for (int i = 0; i < 50000; i++)								// far more than 16KB, so the read-buffer grows.
+			if (!PicoSend(C, Out, TestWrite(Out, Sent++), PicoSendCanTimeOut))
+				return nullptr;
+		PicoSleep(2.5);												// quiet for over 2s, so it shrinks again.
+	}
+	return nullptr;
+}
+
+int TestResize (PicoComms* C) {
+	/// The worker resizes the read-buffer, while we are looking at messages in it with `PicoGetView()`.
+	/// Each view must stay readable, till we release it. Best run under ASan.
+	C->Options |= PicoAdaptiveBuffs;
+	C->MaxBuffSize = 1024*1024;
+	auto C2 = PicoStartChild(C);
+	if (!C2) return -1;
+	pthread_t T = 0;
+	if (pthread_create(&T, nullptr, (void*(*)(void*))TestResizeSend, C))
+		return -1;
+	
+	char Expected[20];
+	int Got = 0; int Resizes = 0; auto Last = C2->Reading;
+	while (Got < 3*50000) {
+		if (Got & 1) {												// `PicoGetMany()` peeks without a lock, first.
+			PicoMessage Many[16];
+			int n = PicoGetMany(C2, Many, 16, 5.0);
+			if (n <= 0) break;
+			bool Same = true;
+			for (int i = 0; Same and i < n; i++) {
+				TestWrite(Expected, Got++);
+				Same = !strcmp(Many[i].Data, Expected);
+			}
+			free(Many[0].Data);
+			if (!Same)
+				return !PicoSay(C2, "Resize differed at", "", Got);
+		} else {
+			auto M = PicoGetView(C2, 5.0);
+			if (!M) break;
+			TestWrite(Expected, Got);
+			if (Got % 100 == 0) PicoSleep(0.001);					// hold on to it, while the worker ticks.
+			bool Same = !strcmp(M.Data, Expected);
+			PicoRelease(C2);
+			if (!Same)
+				return !PicoSay(C2, "Resize differed at", "", Got);
+			Got++;
+		}
+		if (C2->Reading != Last) {Resizes++; Last = C2->Reading;}
+	}
+	pthread_join(T, nullptr);
+	printf("Got %i messages, the read-buffer was resized at least %i times\n", Got, Resizes);
+	if (Got != 3*50000)
+		return !PicoSay(C2, "Resize lost messages", "", Got);
+#if !(PICO_URING and __linux__)
+	if (Resizes < 2)												// io_uring keeps a recv posted into it, so it can't be swapped.
+		return !PicoSay(C2, "Resize never resized");
+#endif
+	PicoSay(C2, "Resize Passed");
+	PicoDestroy(C2, "Finished");
+	return 0;
+}
+
 bool GetAndSayExec (PicoComms* M, float t, int i) {
 	auto Mary = PicoGetCpp(M, fabs(t));
 	if (Mary.Data) {
@@ -599,12 +1547,15 @@ int main (int argc, const char * argv[]) {
 	if mode(alot)
 		return TestPrintAlot();
 	
+	if mode(31)
+		return TestRing();
+	
 	auto C = PicoCreate(S);
 	if mode(exec)
 		return TestExec2(C);
 	
 	puts(SelfPath); // to help me debug this from the terminal. xcode buries builds somewhere.
-	printf("%i --> %.1fK\n", (int)sizeof(PicoComms), (float)sizeof(pico_all)/1024.0);
+	printf("%i --> %.1fK\n", (int)sizeof(PicoComms), (float)sizeof(pico_list)/1024.0);
 	C->Say("Starting Test: ");
 	int rz = 0;
 	if mode(0)
@@ -629,6 +1580,56 @@ int main (int argc, const char * argv[]) {
 		rz = TestSleep(C);
 	  else if mode(10)
 		rz = TestALot(C);
+	  else if mode(11)
+		rz = TestView(PicoCreate("Viewer", 16*1024));
+	  else if mode(12) {
+		auto V = PicoCreate("Mirror", 16*1024);
+		V->Options |= PicoMirrorBuffs;
+		rz = TestView(V);
+	}
+	  else if mode(13) {
+		C->Options |= PicoSharedMem;
+		rz = TestFork(C);
+	} else if mode(14) {
+		C->Options |= PicoSharedMem;
+		rz = TestExec(C);
+	}
+	  else if mode(15)
+		rz = TestMany(C);
+	  else if mode(16)
+		rz = TestCrowd(C);
+	  else if mode(17)
+		rz = TestShards(C);
+	  else if mode(18)
+		rz = TestHuge(PicoCreate("Huge", 16*1024));
+	  else if mode(19)
+		rz = TestAdapt(PicoCreate("Adapt", 16*1024));
+	  else if mode(20)
+		rz = TestPool(C);
+	  else if mode(21)
+		rz = TestInto(PicoCreate("Into", 16*1024));
+	  else if mode(22)
+		rz = TestPack(PicoCreate("Pack", 16*1024));
+	  else if mode(23)
+		rz = TestBatch(C);
+	  else if mode(24)
+		rz = TestTimed(PicoCreate("Timed", 16*1024));
+	  else if mode(25)
+		rz = TestCounts(C);
+	  else if mode(26)
+		rz = TestWait(PicoCreate("Wait", 16*1024));
+	  else if mode(27)
+		rz = TestIdle(C);
+	  else if mode(28)
+		rz = TestWake(C);
+	  else if mode(29)
+		rz = TestBacklog(PicoCreate("Backlog", 16*1024));
+	  else if mode(30)
+		rz = TestWrap(PicoCreate("Wrap", 16*1024));
+	  else if mode(32)
+		rz = TestLastWords(C);
+	  else if mode(33)
+		rz = TestResize(PicoCreate("Resize", 16*1024));
 	  else {
 		errno = ENOTSUP;
 		perror("invalid test mode");